@@ -27,7 +27,11 @@
 
 #include "ffaudioframe.h"
 
-FFAudioFrame::FFAudioFrame() {
+FFAudioFrame::FFAudioFrame():
+    sampleFormat(SampleFormatS16),
+    sampleRate(0),
+    channels(0),
+    sampleCount(0) {
 
 }
 
@@ -35,11 +35,23 @@
 
 class FFAudioFrame: public FFFrame {
 public:
+    /** Output sample format, samples are interleaved */
+    typedef enum {
+        SampleFormatS16,
+        SampleFormatS32,
+        SampleFormatFloat
+    } SampleFormat;
+
     explicit FFAudioFrame();
     virtual ~FFAudioFrame();
 
     QByteArray samples;
 
+    SampleFormat sampleFormat;
+    int sampleRate;
+    int channels;
+    int sampleCount;            // per channel
+
     // FFFrame interface
 public:
     virtual FFFrameType getFrameType();
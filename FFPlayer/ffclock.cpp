@@ -0,0 +1,162 @@
+//
+//  ffclock.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffclock.h"
+
+#include <qmath.h>
+
+FFClock::FFClock() :
+    _baseNsecs(0),
+    _basePosition(0.0),
+    _rate(1.0),
+    _isStarted(false),
+    _isPaused(false),
+    _isAborted(false),
+    _mutex(QMutex::NonRecursive) {
+
+    _timer.start();
+}
+
+void FFClock::start(double position) {
+    QMutexLocker locker(&_mutex);
+    _baseNsecs = _timer.nsecsElapsed();
+    _basePosition = position;
+    _isStarted = true;
+    _changed.wakeAll();
+}
+
+void FFClock::reset() {
+    QMutexLocker locker(&_mutex);
+    _isStarted = false;
+    _isAborted = false;
+    _basePosition = 0.0;
+}
+
+void FFClock::stop() {
+    QMutexLocker locker(&_mutex);
+    _isStarted = false;
+    _changed.wakeAll();
+}
+
+void FFClock::abort() {
+    QMutexLocker locker(&_mutex);
+    _isAborted = true;
+    _changed.wakeAll();
+}
+
+bool FFClock::isStarted() const {
+    QMutexLocker locker(&_mutex);
+    return _isStarted;
+}
+
+double FFClock::time() const {
+    QMutexLocker locker(&_mutex);
+    return timeLocked();
+}
+
+double FFClock::timeLocked() const {
+    if (!_isStarted || _isPaused) {
+        return _basePosition;
+    }
+
+    return _basePosition + (_timer.nsecsElapsed() - _baseNsecs) / 1000000000.0 * _rate;
+}
+
+double FFClock::rate() const {
+    QMutexLocker locker(&_mutex);
+    return _rate;
+}
+
+void FFClock::setRate(double rate) {
+    QMutexLocker locker(&_mutex);
+    if (rate <= 0.0) {
+        return;
+    }
+
+    _basePosition = timeLocked();
+    _baseNsecs = _timer.nsecsElapsed();
+    _rate = rate;
+    _changed.wakeAll();
+}
+
+bool FFClock::isPaused() const {
+    QMutexLocker locker(&_mutex);
+    return _isPaused;
+}
+
+void FFClock::setPaused(bool isPaused) {
+    QMutexLocker locker(&_mutex);
+    if (_isPaused == isPaused) {
+        return;
+    }
+
+    _basePosition = timeLocked();
+    _baseNsecs = _timer.nsecsElapsed();
+    _isPaused = isPaused;
+    _changed.wakeAll();
+}
+
+bool FFClock::waitFor(double position) {
+    QMutexLocker locker(&_mutex);
+
+    forever {
+        if (_isAborted) {
+            return false;
+        }
+
+        if (!_isStarted) {
+            return true;
+        }
+
+        if (_isPaused) {
+            _changed.wait(&_mutex);
+            continue;
+        }
+
+        double remaining = (position - timeLocked()) / _rate;
+        if (remaining <= 0.0) {
+            return true;
+        }
+
+        _changed.wait(&_mutex, static_cast<unsigned long>(qCeil(remaining * 1000.0)));
+    }
+}
+
+int FFClock::remainingMsecs(double position) const {
+    QMutexLocker locker(&_mutex);
+
+    if (_isAborted || !_isStarted) {
+        return 0;
+    }
+
+    if (_isPaused) {
+        return -1;
+    }
+
+    double remaining = (position - timeLocked()) / _rate;
+    return remaining <= 0.0 ? 0 : static_cast<int>(qCeil(remaining * 1000.0));
+}
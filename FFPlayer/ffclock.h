@@ -0,0 +1,88 @@
+//
+//  ffclock.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFCLOCK_H
+#define FFCLOCK_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+
+/**
+ * Presentation clock.
+ *
+ * Maps media positions (in seconds) to a monotonic clock, scaled by the
+ * playback rate. Threads can block in waitFor() until a position is due;
+ * pausing, rate changes and abort() wake them up. Callers that must not
+ * block poll remainingMsecs() instead.
+ */
+class FFClock {
+public:
+    explicit FFClock();
+
+    // Sets the current media position, starting the clock if needed.
+    void start(double position);
+    // Stops the clock and clears the abort flag.
+    void reset();
+    // Stops the clock, the next start() sets the position again.
+    void stop();
+    void abort();
+
+    bool isStarted() const;
+    double time() const;
+
+    double rate() const;
+    void setRate(double rate);
+
+    bool isPaused() const;
+    void setPaused(bool isPaused);
+
+    // False if the clock was aborted before the position was due.
+    // Returns at once while the clock is stopped.
+    bool waitFor(double position);
+    // Msecs until the position is due without blocking, 0 if it is due,
+    // the clock is stopped or aborted, -1 while paused.
+    int remainingMsecs(double position) const;
+
+private:
+    Q_DISABLE_COPY(FFClock)
+
+    double timeLocked() const;
+
+    QElapsedTimer        _timer;
+    qint64               _baseNsecs;
+    double               _basePosition;
+    double               _rate;
+    bool                 _isStarted;
+    bool                 _isPaused;
+    bool                 _isAborted;
+
+    mutable QMutex       _mutex;
+    QWaitCondition       _changed;
+};
+
+#endif // FFCLOCK_H
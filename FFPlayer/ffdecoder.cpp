@@ -31,6 +31,14 @@
 #include "ffaudioframe.h"
 
 #include <QDebug>
+#include <QMutex>
+#include <QVector>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#define MIN_CONVERT_BAND_HEIGHT     64           // rows
+#define MAX_SAMPLE_BUFFERS          16
 
 class FFDecoderPrivate {
     Q_DECLARE_PUBLIC(FFDecoder)
@@ -40,40 +48,408 @@ public:
         audioCodecCtx(0),
         swsContext(0),
         swrContext(0),
-        swrBuffer(0),
         pFrame(0),
-        pFrameRGB(0),
-        buffer(0),
+        pAudioFrame(0),
+        videoParameters(0),
+        audioParameters(0),
         videoStreamIndex(-1),
         audioStreamIndex(-1),
+        decodeVideoStreamIndex(-1),
+        decodeAudioStreamIndex(-1),
         videoTimeBase(0.0),
         audioTimeBase(0.0),
         fps(0.0),
         duration(0.0),
-        pixfmt(AV_PIX_FMT_RGB24)
+        lastPosition(0.0),
+        pendingStreams(),
+        hasPendingVideo(false),
+        hasPendingAudio(false),
+        streamsMutex(QMutex::NonRecursive),
+        swrInLayout(0),
+        swrInFormat(-1),
+        swrInRate(0),
+        swrOutLayout(0),
+        swrOutFormat(-1),
+        swrOutRate(0),
+        statistics(0)
     { }
 
+    FFVideoFramePtr createVideoFrame(AVFrame *source, bool convert);
+    bool convertVideoFrame(AVFrame *source, FFVideoFrame *frame);
+    bool scaleBands(AVFrame *source, int bandCount, AVPixelFormat dstPixFmt, int flags,
+                    uint8_t *dst, int dstLinesize, int dstWidth, int dstHeight);
+
+    AVCodecContext *openCodecContext(AVStream *stream, AVCodec **codec,
+                                     AVCodecParameters **parameters);
+    void openAudioCodec(AVFormatContext *context);
+    FFAudioFramePtr createAudioFrame(AVFrame *source);
+    bool updateSwrContext(AVFrame *source, const FFDecoderOptions &options);
+    QByteArray *sampleBuffer();
+    void applyCodecOptions();
+
+    FFDecoderOptions currentOptions() const;
+
+    // Stage timings, no-ops without statistics.
+    qint64 startStage() const;
+    void finishStage(FFStatistics::Stage stage, qint64 started);
+
 public:
     FFDecoder           *q_ptr;
     AVCodecContext      *videoCodecCtx;
     AVCodecContext      *audioCodecCtx;
     struct SwsContext   *swsContext;
     SwrContext          *swrContext;
-    void                *swrBuffer;
-    AVFrame             *pFrame, *pFrameRGB;
-    uint8_t             *buffer;
+    AVFrame             *pFrame;
+    AVFrame             *pAudioFrame;
+
+    // Stream parameters the codecs were opened with.
+    AVCodecParameters   *videoParameters;
+    AVCodecParameters   *audioParameters;
 
+    // Streams packets are accepted from, demuxing thread.
     int                 videoStreamIndex;
     int                 audioStreamIndex;
 
+    // Streams the codecs decode, decoding thread.
+    int                 decodeVideoStreamIndex;
+    int                 decodeAudioStreamIndex;
     double              videoTimeBase;
     double              audioTimeBase;
     double              fps;
     double              duration;
+    double              lastPosition;
+
+    // Streams of a reattach() the decoding thread has not taken yet.
+    struct Streams {
+        int             videoStreamIndex;
+        int             audioStreamIndex;
+        AVRational      videoPacketTimeBase;
+        AVRational      audioPacketTimeBase;
+        double          videoTimeBase;
+        double          audioTimeBase;
+        double          fps;
+    };
+    Streams             pendingStreams;
+    bool                hasPendingVideo;
+    bool                hasPendingAudio;
+    QMutex              streamsMutex;
+
+    // Guards options, conversion may run on another thread than decoding.
+    FFDecoderOptions    options;
+    mutable QMutex      optionsMutex;
+
+    FFVideoFramePool    framePool;
+
+    // Resampler parameters swrContext was set up for.
+    int64_t             swrInLayout;
+    int                 swrInFormat;
+    int                 swrInRate;
+    int64_t             swrOutLayout;
+    int                 swrOutFormat;
+    int                 swrOutRate;
+
+    // Sample buffers are reused once consumers released them.
+    QVector<QByteArray> sampleBuffers;
 
-    AVPixelFormat       pixfmt;
+    // Slice-parallel conversion, one scaler context per band.
+    QVector<SwsContext *> bandContexts;
+    QThreadPool         convertPool;
+
+    FFStatistics        *statistics;
 };
 
+static void freeAVFrame(AVFrame *frame) {
+    av_frame_free(&frame);
+}
+
+static bool outputPixelFormat(FFVideoFrame::PixelFormat format,
+                              AVPixelFormat *pPixFmt, QImage::Format *pImageFormat) {
+    switch (format) {
+    case FFVideoFrame::PixelFormatRGB888:
+        *pPixFmt = AV_PIX_FMT_RGB24;
+        *pImageFormat = QImage::Format_RGB888;
+        return true;
+    case FFVideoFrame::PixelFormatRGB32:
+        // AV_PIX_FMT_RGB32 is 0xAARRGGBB in native endianness, same as QImage.
+        *pPixFmt = AV_PIX_FMT_RGB32;
+        *pImageFormat = QImage::Format_RGB32;
+        return true;
+    case FFVideoFrame::PixelFormatARGB32Premultiplied:
+        // Video is opaque, so premultiplied and straight alpha are equal.
+        *pPixFmt = AV_PIX_FMT_RGB32;
+        *pImageFormat = QImage::Format_ARGB32_Premultiplied;
+        return true;
+    case FFVideoFrame::PixelFormatGrayscale8:
+        *pPixFmt = AV_PIX_FMT_GRAY8;
+        *pImageFormat = QImage::Format_Grayscale8;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static int swsScaleFlags(FFVideoFrame::ScaleQuality quality) {
+    switch (quality) {
+    case FFVideoFrame::ScaleQualityBilinear:
+        return SWS_BILINEAR;
+    case FFVideoFrame::ScaleQualityBicubic:
+        return SWS_BICUBIC;
+    case FFVideoFrame::ScaleQualityArea:
+        return SWS_AREA;
+    case FFVideoFrame::ScaleQualityPoint:
+        return SWS_POINT;
+    default:
+        return SWS_FAST_BILINEAR;
+    }
+}
+
+static QSize outputSize(const FFDecoderOptions &options, int sourceWidth, int sourceHeight) {
+    QSize size(sourceWidth, sourceHeight);
+    if (!options.outputSize.isEmpty()) {
+        size = size.scaled(options.outputSize, options.aspectRatioMode);
+    }
+
+    return size.expandedTo(QSize(1, 1));
+}
+
+FFDecoderOptions FFDecoderPrivate::currentOptions() const {
+    QMutexLocker optionsLock(&optionsMutex);
+    return options;
+}
+
+qint64 FFDecoderPrivate::startStage() const {
+    return statistics ? FFStatistics::timestamp() : 0;
+}
+
+void FFDecoderPrivate::finishStage(FFStatistics::Stage stage, qint64 started) {
+    if (statistics) {
+        statistics->record(stage, started);
+    }
+}
+
+void FFDecoderPrivate::applyCodecOptions() {
+    if (!videoCodecCtx) {
+        return;
+    }
+
+    videoCodecCtx->skip_loop_filter = currentOptions().fastDecode ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+}
+
+FFVideoFramePtr FFDecoderPrivate::createVideoFrame(AVFrame *source, bool convert) {
+    FFVideoFramePtr frame(new FFVideoFrame);
+
+    // duration
+    frame->duration = duration;
+
+    // fps
+    frame->fps = fps;
+
+    // delay
+    int64_t pktDuration = av_frame_get_pkt_duration(source);
+    if (pktDuration > 0) {
+        frame->frameDelayMsec = pktDuration * videoTimeBase;
+    }
+    else if (fps > 0.0) {
+        frame->frameDelayMsec = 1.0 / fps;
+    }
+    else {
+        frame->frameDelayMsec = videoTimeBase;
+        frame->frameDelayMsec *= videoCodecCtx->ticks_per_frame;
+    }
+    frame->frameDelayMsec += source->repeat_pict * (frame->frameDelayMsec * 0.5);
+    frame->frameDelayMsec *= 1000.0;
+
+    // position, frame timestamps are in the stream time base
+    int64_t pts = av_frame_get_best_effort_timestamp(source);
+    if (pts != AV_NOPTS_VALUE) {
+        frame->position = pts * videoTimeBase;
+    }
+    else {
+        frame->position = lastPosition + frame->frameDelayMsec / 1000.0;
+    }
+    lastPosition = frame->position;
+
+    if (convert) {
+        if (!convertVideoFrame(source, frame.data())) {
+            return FFVideoFramePtr();
+        }
+    }
+    else {
+        // Keep a reference to the decoded planes for FFDecoder::convertFrame().
+        qint64 started = startStage();
+        AVFrame *planes = av_frame_clone(source);
+        finishStage(FFStatistics::StageCopy, started);
+        if (!planes) {
+            return FFVideoFramePtr();
+        }
+
+        frame->avFrame = QSharedPointer<AVFrame>(planes, freeAVFrame);
+        frame->pixelFormat = FFVideoFrame::PixelFormatYUV;
+        frame->width = source->width;
+        frame->height = source->height;
+    }
+
+    return frame;
+}
+
+bool FFDecoderPrivate::convertVideoFrame(AVFrame *source, FFVideoFrame *frame) {
+    FFDecoderOptions options = currentOptions();
+
+    frame->pixelFormat = options.outputFormat;
+    frame->width = source->width;
+    frame->height = source->height;
+
+    // Passthrough, hand out a reference to the decoded planes.
+    if (options.outputFormat == FFVideoFrame::PixelFormatYUV) {
+        if (frame->avFrame) {
+            return true;
+        }
+
+        qint64 started = startStage();
+        AVFrame *planes = av_frame_clone(source);
+        finishStage(FFStatistics::StageCopy, started);
+        if (!planes) {
+            return false;
+        }
+
+        frame->avFrame = QSharedPointer<AVFrame>(planes, freeAVFrame);
+        return true;
+    }
+
+    AVPixelFormat dstPixFmt;
+    QImage::Format imageFormat;
+    if (!outputPixelFormat(options.outputFormat, &dstPixFmt, &imageFormat)) {
+        return false;
+    }
+
+    // Downscale inside the conversion step.
+    QSize size = outputSize(options, source->width, source->height);
+    frame->width = size.width();
+    frame->height = size.height();
+
+    // Convert the frame straight into a pooled QImage buffer.
+    // Pooled lines are 64-byte aligned, so swscale keeps its SIMD paths.
+    qint64 started = startStage();
+    frame->image = framePool.acquire(frame->width, frame->height, imageFormat);
+    finishStage(FFStatistics::StageCopy, started);
+    if (!frame->image) {
+        return false;
+    }
+
+    started = startStage();
+
+    int flags = swsScaleFlags(options.scaleQuality);
+
+    // Split large frames into horizontal bands converted in parallel.
+    // Vertical filters would need the rows of the neighbouring bands, so
+    // only frames that keep their height are split.
+    int threadCount = options.conversionThreads > 0 ? options.conversionThreads
+                                                    : QThread::idealThreadCount();
+    int bandCount = qMin(threadCount, frame->height / MIN_CONVERT_BAND_HEIGHT);
+    if (bandCount > 1 && frame->height == source->height && scaleBands(source, bandCount, dstPixFmt, flags,
+                                    frame->image->bits(), frame->image->bytesPerLine(),
+                                    frame->width, frame->height)) {
+        finishStage(FFStatistics::StageConvert, started);
+        return true;
+    }
+
+    // Reuses the current context unless the source or output parameters changed.
+    swsContext = sws_getCachedContext(swsContext, source->width, source->height,
+                                      static_cast<AVPixelFormat>(source->format),
+                                      frame->width, frame->height, dstPixFmt,
+                                      flags, NULL, NULL, NULL);
+    if (!swsContext) {
+        return false;
+    }
+
+    uint8_t *dstData[4] = { frame->image->bits(), 0, 0, 0 };
+    int dstLinesize[4] = { frame->image->bytesPerLine(), 0, 0, 0 };
+    sws_scale(swsContext, source->data, source->linesize, 0,
+              source->height, dstData, dstLinesize);
+    finishStage(FFStatistics::StageConvert, started);
+
+    return true;
+}
+
+bool FFDecoderPrivate::scaleBands(AVFrame *source, int bandCount, AVPixelFormat dstPixFmt, int flags,
+                                  uint8_t *dst, int dstLinesize, int dstWidth, int dstHeight) {
+    AVPixelFormat srcPixFmt = static_cast<AVPixelFormat>(source->format);
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(srcPixFmt);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL))) {
+        return false;
+    }
+
+    // Bands scaled on their own only match one pass without vertical scaling.
+    if (dstHeight != source->height) {
+        return false;
+    }
+
+    // Band borders in the source must fall on whole chroma rows, the
+    // destination rows are the same.
+    int align = 1 << desc->log2_chroma_h;
+    QVector<int> srcY(bandCount + 1);
+    QVector<int> dstY(bandCount + 1);
+    for (int i = 0; i < bandCount; i++) {
+        srcY[i] = static_cast<int>(static_cast<qint64>(source->height) * i / bandCount) & ~(align - 1);
+        dstY[i] = static_cast<int>(static_cast<qint64>(srcY[i]) * dstHeight / source->height);
+    }
+    srcY[bandCount] = source->height;
+    dstY[bandCount] = dstHeight;
+
+    if (bandContexts.count() != bandCount) {
+        for (int i = 0; i < bandContexts.count(); i++) {
+            sws_freeContext(bandContexts[i]);
+        }
+        bandContexts.fill(0, bandCount);
+    }
+
+    for (int i = 0; i < bandCount; i++) {
+        if (srcY[i + 1] <= srcY[i] || dstY[i + 1] <= dstY[i]) {
+            return false;
+        }
+
+        bandContexts[i] = sws_getCachedContext(bandContexts[i], source->width, srcY[i + 1] - srcY[i],
+                                               srcPixFmt, dstWidth, dstY[i + 1] - dstY[i], dstPixFmt,
+                                               flags, NULL, NULL, NULL);
+        if (!bandContexts[i]) {
+            return false;
+        }
+    }
+
+    auto scaleBand = [this, source, desc, dst, dstLinesize, &srcY, &dstY](int band) {
+        const uint8_t *srcData[4] = { 0, 0, 0, 0 };
+        for (int plane = 0; plane < 4; plane++) {
+            if (source->data[plane]) {
+                int shift = (plane == 1 || plane == 2) ? desc->log2_chroma_h : 0;
+                srcData[plane] = source->data[plane] + (srcY[band] >> shift) * source->linesize[plane];
+            }
+        }
+
+        uint8_t *dstData[4] = { dst + dstY[band] * dstLinesize, 0, 0, 0 };
+        int dstLinesizes[4] = { dstLinesize, 0, 0, 0 };
+        sws_scale(bandContexts[band], srcData, source->linesize, 0,
+                  srcY[band + 1] - srcY[band], dstData, dstLinesizes);
+    };
+
+    convertPool.setMaxThreadCount(bandCount - 1);
+
+    // The calling thread converts the first band itself.
+    QVector<QFuture<void> > futures;
+    for (int i = 1; i < bandCount; i++) {
+        futures.append(QtConcurrent::run(&convertPool, [&scaleBand, i]() {
+            scaleBand(i);
+        }));
+    }
+
+    scaleBand(0);
+
+    for (int i = 0; i < futures.count(); i++) {
+        futures[i].waitForFinished();
+    }
+
+    return true;
+}
+
 static void avStreamFPSTimeBase(AVStream *st, double defaultTimeBase,
                                 double *pFPS, double *pTimeBase) {
     double fps, timebase;
@@ -98,146 +474,672 @@ static void avStreamFPSTimeBase(AVStream *st, double defaultTimeBase,
         *pTimeBase = timebase;
 }
 
+static AVSampleFormat outputSampleFormat(FFAudioFrame::SampleFormat format) {
+    switch (format) {
+    case FFAudioFrame::SampleFormatS32:
+        return AV_SAMPLE_FMT_S32;
+    case FFAudioFrame::SampleFormatFloat:
+        return AV_SAMPLE_FMT_FLT;
+    default:
+        return AV_SAMPLE_FMT_S16;
+    }
+}
+
+static bool isSameParameters(const AVCodecParameters *a, const AVCodecParameters *b) {
+    return a->codec_type == b->codec_type &&
+            a->codec_id == b->codec_id &&
+            a->format == b->format &&
+            a->width == b->width &&
+            a->height == b->height &&
+            a->sample_rate == b->sample_rate &&
+            a->channels == b->channels &&
+            a->channel_layout == b->channel_layout &&
+            a->extradata_size == b->extradata_size &&
+            (a->extradata_size == 0 || memcmp(a->extradata, b->extradata, a->extradata_size) == 0);
+}
+
+AVCodecContext *FFDecoderPrivate::openCodecContext(AVStream *stream, AVCodec **codec,
+                                                   AVCodecParameters **parameters) {
+    *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!*codec) {
+        return 0;
+    }
+
+    // Owned by the decoder rather than the stream, so it outlives the
+    // format context when the source is reconnected.
+    AVCodecContext *codecCtx = avcodec_alloc_context3(*codec);
+    if (!codecCtx) {
+        return 0;
+    }
+
+    *parameters = avcodec_parameters_alloc();
+    if (!*parameters ||
+            avcodec_parameters_copy(*parameters, stream->codecpar) < 0 ||
+            avcodec_parameters_to_context(codecCtx, stream->codecpar) < 0) {
+        avcodec_parameters_free(parameters);
+        avcodec_free_context(&codecCtx);
+        return 0;
+    }
+
+    av_codec_set_pkt_timebase(codecCtx, stream->time_base);
+
+    return codecCtx;
+}
+
+void FFDecoderPrivate::openAudioCodec(AVFormatContext *context) {
+    audioStreamIndex = av_find_best_stream(context, AVMEDIA_TYPE_AUDIO, -1, -1, 0, 0);
+    if (audioStreamIndex < 0) {
+        return;
+    }
+
+    // Load audio codec
+    AVCodec *audioDecoder = 0;
+    audioCodecCtx = openCodecContext(context->streams[audioStreamIndex], &audioDecoder,
+                                     &audioParameters);
+    if (!audioCodecCtx) {
+        return;
+    }
+
+    if (avcodec_open2(audioCodecCtx, audioDecoder, 0) < 0) {
+        return;
+    }
+
+    // Allocate audio frame
+    pAudioFrame = av_frame_alloc();
+
+    avStreamFPSTimeBase(context->streams[audioStreamIndex], 0.025, 0, &audioTimeBase);
+    decodeAudioStreamIndex = audioStreamIndex;
+}
+
+bool FFDecoderPrivate::updateSwrContext(AVFrame *source, const FFDecoderOptions &options) {
+    int64_t inLayout = source->channel_layout;
+    if (!inLayout || av_get_channel_layout_nb_channels(inLayout) != av_frame_get_channels(source)) {
+        inLayout = av_get_default_channel_layout(av_frame_get_channels(source));
+    }
+
+    int outChannels = options.audioChannels > 0 ? options.audioChannels : av_frame_get_channels(source);
+    int64_t outLayout = outChannels == av_frame_get_channels(source) ? inLayout
+                                                                     : av_get_default_channel_layout(outChannels);
+    int outFormat = outputSampleFormat(options.audioSampleFormat);
+    int outRate = options.audioSampleRate > 0 ? options.audioSampleRate : source->sample_rate;
+
+    if (swrContext && inLayout == swrInLayout && source->format == swrInFormat &&
+            source->sample_rate == swrInRate && outLayout == swrOutLayout &&
+            outFormat == swrOutFormat && outRate == swrOutRate) {
+        return true;
+    }
+
+    swr_free(&swrContext);
+    swrContext = swr_alloc_set_opts(NULL, outLayout, static_cast<AVSampleFormat>(outFormat), outRate,
+                                    inLayout, static_cast<AVSampleFormat>(source->format),
+                                    source->sample_rate, 0, NULL);
+    if (!swrContext || swr_init(swrContext) < 0) {
+        swr_free(&swrContext);
+        return false;
+    }
+
+    swrInLayout = inLayout;
+    swrInFormat = source->format;
+    swrInRate = source->sample_rate;
+    swrOutLayout = outLayout;
+    swrOutFormat = outFormat;
+    swrOutRate = outRate;
+
+    return true;
+}
+
+QByteArray *FFDecoderPrivate::sampleBuffer() {
+    // A buffer is free again when no frame shares it any more.
+    for (int i = 0; i < sampleBuffers.count(); i++) {
+        if (sampleBuffers[i].isDetached()) {
+            return &sampleBuffers[i];
+        }
+    }
+
+    if (sampleBuffers.count() < MAX_SAMPLE_BUFFERS) {
+        sampleBuffers.append(QByteArray());
+        return &sampleBuffers.last();
+    }
+
+    return 0;
+}
+
+FFAudioFramePtr FFDecoderPrivate::createAudioFrame(AVFrame *source) {
+    FFDecoderOptions options = currentOptions();
+    if (!updateSwrContext(source, options)) {
+        return FFAudioFramePtr();
+    }
+
+    int outChannels = av_get_channel_layout_nb_channels(swrOutLayout);
+    AVSampleFormat outFormat = static_cast<AVSampleFormat>(swrOutFormat);
+    int maxSamples = static_cast<int>(av_rescale_rnd(swr_get_delay(swrContext, swrInRate) + source->nb_samples,
+                                                     swrOutRate, swrInRate, AV_ROUND_UP));
+    int maxSize = av_samples_get_buffer_size(NULL, outChannels, maxSamples, outFormat, 1);
+    if (maxSize <= 0) {
+        return FFAudioFramePtr();
+    }
+
+    // Resample straight into a reused buffer, resize() keeps its capacity.
+    QByteArray localBuffer;
+    QByteArray *buffer = sampleBuffer();
+    if (!buffer) {
+        buffer = &localBuffer;
+    }
+    buffer->resize(maxSize);
+
+    uint8_t *out = reinterpret_cast<uint8_t *>(buffer->data());
+    int samples = swr_convert(swrContext, &out, maxSamples,
+                              const_cast<const uint8_t **>(source->extended_data), source->nb_samples);
+    if (samples <= 0) {
+        return FFAudioFramePtr();
+    }
+
+    buffer->resize(av_samples_get_buffer_size(NULL, outChannels, samples, outFormat, 1));
+
+    FFAudioFramePtr frame(new FFAudioFrame);
+    frame->samples = *buffer;
+    frame->sampleFormat = options.audioSampleFormat;
+    frame->sampleRate = swrOutRate;
+    frame->channels = outChannels;
+    frame->sampleCount = samples;
+
+    // duration
+    frame->duration = duration;
+
+    // delay
+    frame->frameDelayMsec = samples * 1000.0 / swrOutRate;
+
+    // position
+    int64_t pts = av_frame_get_best_effort_timestamp(source);
+    if (pts != AV_NOPTS_VALUE) {
+        frame->position = pts * audioTimeBase;
+    }
+
+    return frame;
+}
+
 FFDecoder::FFDecoder(AVFormatContext *context, QObject *parent) :
+    FFDecoder(context, FFDecoderOptions(), parent) {
+
+}
+
+FFDecoder::FFDecoder(AVFormatContext *context, const FFDecoderOptions &options, QObject *parent) :
     QObject(parent),
     d_ptr(new FFDecoderPrivate()) {
 
     Q_D(FFDecoder);
     d->q_ptr = this;
+    d->options = options;
+
+    // duration
+    if (context->duration == AV_NOPTS_VALUE) {
+        d_ptr->duration = std::numeric_limits<float>::max();
+    }
+    else {
+        d_ptr->duration = (double)context->duration / (double)AV_TIME_BASE;
+    }
+
+    d_ptr->openAudioCodec(context);
 
     // get a pointer to the codec context for the video or audio stream
     // find all streams that the library is able to decode
     d_ptr->videoStreamIndex = av_find_best_stream(context, AVMEDIA_TYPE_VIDEO, -1, -1, 0, 0);
     if (d_ptr->videoStreamIndex >= 0) {
-        d_ptr->videoCodecCtx = context->streams[d_ptr->videoStreamIndex]->codec;
-
         // Load video codec
-        AVCodec *videoDecoder = avcodec_find_decoder(d_ptr->videoCodecCtx->codec_id);
-        if (!videoDecoder) {
+        AVCodec *videoDecoder = 0;
+        d_ptr->videoCodecCtx = d_ptr->openCodecContext(context->streams[d_ptr->videoStreamIndex],
+                                                       &videoDecoder, &d_ptr->videoParameters);
+        if (!d_ptr->videoCodecCtx) {
             return;
         }
 
-        if (avcodec_open2(d_ptr->videoCodecCtx, videoDecoder, 0) < 0 ) {
-            return;
+        // Keep decoded frames valid after the next decode call,
+        // so they can be handed out without a copy.
+        d_ptr->videoCodecCtx->refcounted_frames = 1;
+
+        // Threading
+        d_ptr->videoCodecCtx->thread_count = qMax(0, d_ptr->options.threadCount);
+        switch (d_ptr->options.threadType) {
+        case FFDecoderOptions::ThreadTypeFrame:
+            d_ptr->videoCodecCtx->thread_type = FF_THREAD_FRAME;
+            break;
+        case FFDecoderOptions::ThreadTypeSlice:
+            d_ptr->videoCodecCtx->thread_type = FF_THREAD_SLICE;
+            break;
+        default:
+            d_ptr->videoCodecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+            break;
+        }
+
+        if (d_ptr->options.lowDelay) {
+            d_ptr->videoCodecCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+            d_ptr->videoCodecCtx->thread_type = FF_THREAD_SLICE;
         }
 
-        d_ptr->swsContext = sws_getCachedContext(0, d_ptr->videoCodecCtx->width, d_ptr->videoCodecCtx->height,
-                                                 d_ptr->videoCodecCtx->pix_fmt, d_ptr->videoCodecCtx->width,
-                                                 d_ptr->videoCodecCtx->height, d_ptr->pixfmt,
-                                                 SWS_FAST_BILINEAR, NULL, NULL, NULL);
+        if (d_ptr->options.fastDecode) {
+            d_ptr->videoCodecCtx->flags2 |= AV_CODEC_FLAG2_FAST;
 
-        if (!d_ptr->swsContext) {
+            // Decode at the lowest resolution that still covers the output size.
+            if (!d_ptr->options.outputSize.isEmpty()) {
+                QSize size = outputSize(d_ptr->options, d_ptr->videoCodecCtx->width,
+                                        d_ptr->videoCodecCtx->height);
+                int lowres = 0;
+                while (lowres < av_codec_get_max_lowres(videoDecoder) &&
+                       (d_ptr->videoCodecCtx->width >> (lowres + 1)) >= size.width() &&
+                       (d_ptr->videoCodecCtx->height >> (lowres + 1)) >= size.height()) {
+                    lowres++;
+                }
+
+                av_codec_set_lowres(d_ptr->videoCodecCtx, lowres);
+            }
+        }
+
+        if (avcodec_open2(d_ptr->videoCodecCtx, videoDecoder, 0) < 0 ) {
             return;
         }
 
+        d_ptr->applyCodecOptions();
+
         // Allocate video frame
         d_ptr->pFrame = av_frame_alloc();
 
-        // Allocate an AVFrame structure
-        d_ptr->pFrameRGB = av_frame_alloc();
+        //
+        avStreamFPSTimeBase(context->streams[d_ptr->videoStreamIndex], 0.0, &d_ptr->fps, &d_ptr->videoTimeBase);
+        d_ptr->decodeVideoStreamIndex = d_ptr->videoStreamIndex;
+    }
+}
 
-        // Determine required buffer size and allocate buffer
-        int numBytes = av_image_get_buffer_size(d_ptr->pixfmt, d_ptr->videoCodecCtx->width,
-                                                d_ptr->videoCodecCtx->height, 1);
-        d_ptr->buffer = (uint8_t *)av_malloc(numBytes*sizeof(uint8_t));
+FFDecoder::~FFDecoder() {
+    // Free the YUV frame
+    if (d_ptr->pFrame) {
+        av_frame_free(&d_ptr->pFrame);
+    }
 
-        // Assign appropriate parts of buffer to image planes in pFrameRGB
-        // Note that pFrameRGB is an AVFrame, but AVFrame is a superset
-        // of AVPicture
-        avpicture_fill((AVPicture *)d_ptr->pFrameRGB, d_ptr->buffer, d_ptr->pixfmt,
-                       d_ptr->videoCodecCtx->width, d_ptr->videoCodecCtx->height);
+    if (d_ptr->pAudioFrame) {
+        av_frame_free(&d_ptr->pAudioFrame);
+    }
 
-        //
-        avStreamFPSTimeBase(context->streams[d_ptr->videoStreamIndex], 0.0, &d_ptr->fps, &d_ptr->videoTimeBase);
+    swr_free(&d_ptr->swrContext);
 
-        // duration
-        if (context->duration == AV_NOPTS_VALUE) {
-            d_ptr->duration = std::numeric_limits<float>::max();
-        }
-        else {
-            d_ptr->duration = (double)context->duration / (double)AV_TIME_BASE;
+    if (d_ptr->swsContext) {
+        sws_freeContext(d_ptr->swsContext);
+    }
+
+    // Band workers only run inside convertFrame(), nothing is pending here.
+    for (int i = 0; i < d_ptr->bandContexts.count(); i++) {
+        sws_freeContext(d_ptr->bandContexts[i]);
+    }
+
+    if (d_ptr->videoCodecCtx) {
+        // Release frames still held by the codec threads before closing.
+        if (avcodec_is_open(d_ptr->videoCodecCtx)) {
+            avcodec_flush_buffers(d_ptr->videoCodecCtx);
         }
+
+        avcodec_free_context(&d_ptr->videoCodecCtx);
     }
 
-    d_ptr->audioStreamIndex = av_find_best_stream(context, AVMEDIA_TYPE_AUDIO, -1, -1, 0, 0);
-    if (d_ptr->audioStreamIndex >= 0) {
-        d_ptr->audioCodecCtx = context->streams[d_ptr->audioStreamIndex]->codec;
+    if (d_ptr->audioCodecCtx) {
+        avcodec_free_context(&d_ptr->audioCodecCtx);
     }
+
+    avcodec_parameters_free(&d_ptr->videoParameters);
+    avcodec_parameters_free(&d_ptr->audioParameters);
 }
 
-FFDecoder::~FFDecoder() {
-    // Free the RGB image
-    if (d_ptr->buffer) {
-        av_free(d_ptr->buffer);
+bool FFDecoder::reattach(AVFormatContext *context) {
+    Q_D(FFDecoder);
+
+    int videoIndex = av_find_best_stream(context, AVMEDIA_TYPE_VIDEO, -1, -1, 0, 0);
+    int audioIndex = av_find_best_stream(context, AVMEDIA_TYPE_AUDIO, -1, -1, 0, 0);
+
+    // The open codecs only fit streams with the same parameters.
+    if ((d->videoParameters != 0) != (videoIndex >= 0) ||
+            (d->audioParameters != 0) != (audioIndex >= 0)) {
+        return false;
     }
 
-    if (d_ptr->pFrameRGB) {
-        av_frame_free(&d_ptr->pFrameRGB);
+    if (d->videoParameters &&
+            !isSameParameters(d->videoParameters, context->streams[videoIndex]->codecpar)) {
+        return false;
     }
 
-    // Free the YUV frame
-    if (d_ptr->pFrame) {
-        av_frame_free(&d_ptr->pFrame);
+    if (d->audioParameters &&
+            !isSameParameters(d->audioParameters, context->streams[audioIndex]->codecpar)) {
+        return false;
     }
 
-    if (d_ptr->swsContext) {
-        sws_freeContext(d_ptr->swsContext);
+    // The codecs may be decoding packets of the old source right now,
+    // the decoding thread takes the streams over in applyReattach().
+    QMutexLocker locker(&d->streamsMutex);
+
+    if (d->videoParameters) {
+        AVStream *stream = context->streams[videoIndex];
+        d->pendingStreams.videoStreamIndex = videoIndex;
+        d->pendingStreams.videoPacketTimeBase = stream->time_base;
+        avStreamFPSTimeBase(stream, 0.0, &d->pendingStreams.fps, &d->pendingStreams.videoTimeBase);
+        d->videoStreamIndex = videoIndex;
     }
 
-    if (d_ptr->videoCodecCtx) {
-        avcodec_close(d_ptr->videoCodecCtx);
+    if (d->audioParameters) {
+        AVStream *stream = context->streams[audioIndex];
+        d->pendingStreams.audioStreamIndex = audioIndex;
+        d->pendingStreams.audioPacketTimeBase = stream->time_base;
+        avStreamFPSTimeBase(stream, 0.025, 0, &d->pendingStreams.audioTimeBase);
+        d->audioStreamIndex = audioIndex;
     }
+
+    d->hasPendingVideo = d->videoParameters != 0;
+    d->hasPendingAudio = d->audioParameters != 0;
+    return true;
 }
 
-QList<FFFramePtr> FFDecoder::decodeFrames(AVPacket *packet) {
+void FFDecoder::applyReattach(FFFrame::FFFrameType type) {
+    Q_D(FFDecoder);
+
+    QMutexLocker locker(&d->streamsMutex);
+    const FFDecoderPrivate::Streams &streams = d->pendingStreams;
+
+    if (type == FFFrame::FFFrameTypeVideo && d->hasPendingVideo) {
+        d->decodeVideoStreamIndex = streams.videoStreamIndex;
+        av_codec_set_pkt_timebase(d->videoCodecCtx, streams.videoPacketTimeBase);
+        d->fps = streams.fps;
+        d->videoTimeBase = streams.videoTimeBase;
+        d->hasPendingVideo = false;
+    }
+
+    if (type == FFFrame::FFFrameTypeAudio && d->hasPendingAudio) {
+        d->decodeAudioStreamIndex = streams.audioStreamIndex;
+        av_codec_set_pkt_timebase(d->audioCodecCtx, streams.audioPacketTimeBase);
+        d->audioTimeBase = streams.audioTimeBase;
+        d->hasPendingAudio = false;
+    }
+}
+
+QList<FFFramePtr> FFDecoder::decodeFrames(AVPacket *packet, bool convert) {
+    FFFrame::FFFrameType type = packet->stream_index == d_ptr->decodeVideoStreamIndex ?
+                                FFFrame::FFFrameTypeVideo : FFFrame::FFFrameTypeAudio;
+    return decodeFrames(type, packet, convert);
+}
+
+QList<FFFramePtr> FFDecoder::decodeFrames(FFFrame::FFFrameType type, AVPacket *packet, bool convert) {
     QList<FFFramePtr> result;
     // decode frames from packet
-    if (packet->stream_index == d_ptr->videoStreamIndex) {
+    if (type == FFFrame::FFFrameTypeVideo) {
+        if (packet->stream_index != d_ptr->decodeVideoStreamIndex || !d_ptr->pFrame) {
+            return result;
+        }
+
         int gotframe = 0;
+        qint64 started = d_ptr->startStage();
         int length = avcodec_decode_video2(d_ptr->videoCodecCtx, d_ptr->pFrame,
                                            &gotframe, packet);
+        d_ptr->finishStage(FFStatistics::StageDecode, started);
 
         if (length <= 0) {
             return result;
         }
 
         if (gotframe) {
-            sws_scale(d_ptr->swsContext, d_ptr->pFrame->data, d_ptr->pFrame->linesize, 0,
-                      d_ptr->videoCodecCtx->height, d_ptr->pFrameRGB->data, d_ptr->pFrameRGB->linesize);
+            if (d_ptr->statistics) {
+                d_ptr->statistics->addDecodedFrames(1);
+            }
 
-            QSharedPointer<FFVideoFrame> frame(new FFVideoFrame);
-            frame->width = d_ptr->videoCodecCtx->width;
-            frame->height = d_ptr->videoCodecCtx->height;
+            FFVideoFramePtr frame = d_ptr->createVideoFrame(d_ptr->pFrame, convert);
+            if (frame) {
+                result.append(frame);
+            }
 
-            // position
-            frame->position = av_frame_get_best_effort_timestamp(d_ptr->pFrame) *
-                    av_q2d(d_ptr->videoCodecCtx->time_base);
+            av_frame_unref(d_ptr->pFrame);
+        }
+    }
+    else if (packet->stream_index == d_ptr->decodeAudioStreamIndex && d_ptr->pAudioFrame &&
+             d_ptr->currentOptions().decodeAudio) {
+        // A packet may hold several audio frames.
+        AVPacket remaining = *packet;
+        while (remaining.size > 0) {
+            int gotframe = 0;
+            int length = avcodec_decode_audio4(d_ptr->audioCodecCtx, d_ptr->pAudioFrame,
+                                               &gotframe, &remaining);
+            if (length < 0) {
+                break;
+            }
+
+            if (gotframe) {
+                FFAudioFramePtr frame = d_ptr->createAudioFrame(d_ptr->pAudioFrame);
+                if (frame) {
+                    result.append(frame);
+                }
+
+                av_frame_unref(d_ptr->pAudioFrame);
+            }
+
+            if (length == 0 && !gotframe) {
+                break;
+            }
+
+            remaining.data += length;
+            remaining.size -= length;
+        }
+    }
 
-            // duration
-            frame->duration = d_ptr->duration;
+    return result;
+}
+
+QList<FFFramePtr> FFDecoder::drainFrames(bool convert) {
+    return drainFrames(FFFrame::FFFrameTypeAudio, convert) +
+           drainFrames(FFFrame::FFFrameTypeVideo, convert);
+}
+
+QList<FFFramePtr> FFDecoder::drainFrames(FFFrame::FFFrameType type, bool convert) {
+    QList<FFFramePtr> result;
 
-            // fps
-            frame->fps = d_ptr->fps;
+    // Frame threading and reordering keep frames inside the codec,
+    // feed empty packets until it has nothing left.
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = NULL;
+    packet.size = 0;
 
-            // delay
-            frame->frameDelayMsec = d_ptr->videoTimeBase;
-            frame->frameDelayMsec *= d_ptr->videoCodecCtx->ticks_per_frame;
-            frame->frameDelayMsec += d_ptr->pFrame->repeat_pict * (frame->frameDelayMsec * 0.5);
-            frame->frameDelayMsec *= 1000.0;
+    if (type == FFFrame::FFFrameTypeAudio) {
+        if (!d_ptr->pAudioFrame || !d_ptr->currentOptions().decodeAudio ||
+                !(d_ptr->audioCodecCtx->codec->capabilities & AV_CODEC_CAP_DELAY)) {
+            return result;
+        }
 
-            // Convert the frame to QImage
-            frame->image = QSharedPointer<QImage>(new QImage(d_ptr->videoCodecCtx->width,
-                                                             d_ptr->videoCodecCtx->height,
-                                                             QImage::Format_RGB888));
+        forever {
+            int gotframe = 0;
+            if (avcodec_decode_audio4(d_ptr->audioCodecCtx, d_ptr->pAudioFrame, &gotframe, &packet) < 0 ||
+                    !gotframe) {
+                break;
+            }
 
-            for (int y = 0; y < frame->image->height(); y++) {
-                memcpy(frame->image->scanLine(y), d_ptr->pFrameRGB->data[0] + y*d_ptr->pFrameRGB->linesize[0],
-                        d_ptr->videoCodecCtx->width * 3);
+            FFAudioFramePtr frame = d_ptr->createAudioFrame(d_ptr->pAudioFrame);
+            if (frame) {
+                result.append(frame);
             }
 
+            av_frame_unref(d_ptr->pAudioFrame);
+        }
+
+        return result;
+    }
+
+    if (!d_ptr->pFrame || !avcodec_is_open(d_ptr->videoCodecCtx)) {
+        return result;
+    }
+
+    forever {
+        int gotframe = 0;
+        qint64 started = d_ptr->startStage();
+        int length = avcodec_decode_video2(d_ptr->videoCodecCtx, d_ptr->pFrame, &gotframe, &packet);
+        d_ptr->finishStage(FFStatistics::StageDecode, started);
+
+        if (length < 0 || !gotframe) {
+            break;
+        }
+
+        if (d_ptr->statistics) {
+            d_ptr->statistics->addDecodedFrames(1);
+        }
+
+        FFVideoFramePtr frame = d_ptr->createVideoFrame(d_ptr->pFrame, convert);
+        if (frame) {
             result.append(frame);
         }
+
+        av_frame_unref(d_ptr->pFrame);
     }
 
     return result;
 }
+
+bool FFDecoder::convertFrame(const FFFramePtr &frame) {
+    if (frame->getFrameType() != FFFrame::FFFrameTypeVideo) {
+        return true;
+    }
+
+    FFVideoFramePtr videoFrame = qSharedPointerCast<FFVideoFrame>(frame);
+    if (!videoFrame->avFrame) {
+        return !videoFrame->image.isNull();
+    }
+
+    if (!d_ptr->convertVideoFrame(videoFrame->avFrame.data(), videoFrame.data())) {
+        return false;
+    }
+
+    // Release the decoded planes as soon as they are converted.
+    if (videoFrame->pixelFormat != FFVideoFrame::PixelFormatYUV) {
+        videoFrame->avFrame.clear();
+    }
+
+    return true;
+}
+
+void FFDecoder::flush() {
+    flush(FFFrame::FFFrameTypeVideo);
+    flush(FFFrame::FFFrameTypeAudio);
+}
+
+void FFDecoder::flush(FFFrame::FFFrameType type) {
+    if (type == FFFrame::FFFrameTypeVideo) {
+        if (d_ptr->videoCodecCtx && avcodec_is_open(d_ptr->videoCodecCtx)) {
+            avcodec_flush_buffers(d_ptr->videoCodecCtx);
+        }
+        return;
+    }
+
+    if (d_ptr->audioCodecCtx && avcodec_is_open(d_ptr->audioCodecCtx)) {
+        avcodec_flush_buffers(d_ptr->audioCodecCtx);
+    }
+
+    // Drop samples buffered inside the resampler.
+    swr_free(&d_ptr->swrContext);
+}
+
+bool FFDecoder::acceptsPacket(const AVPacket *packet) const {
+    Q_D(const FFDecoder);
+
+    if (packet->stream_index == d->videoStreamIndex) {
+        return d->pFrame != 0;
+    }
+
+    if (packet->stream_index == d->audioStreamIndex) {
+        return d->pAudioFrame != 0 && d->currentOptions().decodeAudio;
+    }
+
+    return false;
+}
+
+bool FFDecoder::isVideoPacket(const AVPacket *packet) const {
+    return packet->stream_index == d_ptr->decodeVideoStreamIndex;
+}
+
+AVDiscard FFDecoder::skipFrame() const {
+    Q_D(const FFDecoder);
+    return d->videoCodecCtx ? d->videoCodecCtx->skip_frame : AVDISCARD_DEFAULT;
+}
+
+void FFDecoder::setSkipFrame(AVDiscard discard) {
+    Q_D(FFDecoder);
+    if (d->videoCodecCtx) {
+        d->videoCodecCtx->skip_frame = discard;
+    }
+}
+
+bool FFDecoder::isOpen() const {
+    Q_D(const FFDecoder);
+    return (d->videoCodecCtx && avcodec_is_open(d->videoCodecCtx)) ||
+            (d->audioCodecCtx && avcodec_is_open(d->audioCodecCtx));
+}
+
+int FFDecoder::videoStreamIndex() const {
+    Q_D(const FFDecoder);
+    return d->videoStreamIndex;
+}
+
+int FFDecoder::audioStreamIndex() const {
+    Q_D(const FFDecoder);
+    return d->audioStreamIndex;
+}
+
+FFVideoFramePool FFDecoder::framePool() const {
+    Q_D(const FFDecoder);
+    return d->framePool;
+}
+
+void FFDecoder::setFramePool(const FFVideoFramePool &framePool) {
+    Q_D(FFDecoder);
+    d->framePool = framePool;
+}
+
+FFStatistics *FFDecoder::statistics() const {
+    Q_D(const FFDecoder);
+    return d->statistics;
+}
+
+void FFDecoder::setStatistics(FFStatistics *statistics) {
+    Q_D(FFDecoder);
+    d->statistics = statistics;
+}
+
+FFDecoderOptions FFDecoder::options() const {
+    Q_D(const FFDecoder);
+    return d->currentOptions();
+}
+
+void FFDecoder::setOptions(const FFDecoderOptions &options) {
+    Q_D(FFDecoder);
+
+    {
+        QMutexLocker optionsLock(&d->optionsMutex);
+        d->options = options;
+    }
+
+    d->applyCodecOptions();
+}
+
+FFVideoFrame::PixelFormat FFDecoder::outputFormat() const {
+    Q_D(const FFDecoder);
+    return d->currentOptions().outputFormat;
+}
+
+void FFDecoder::setOutputFormat(FFVideoFrame::PixelFormat format) {
+    Q_D(FFDecoder);
+
+    QMutexLocker optionsLock(&d->optionsMutex);
+    d->options.outputFormat = format;
+}
+
+QSize FFDecoder::outputSize() const {
+    Q_D(const FFDecoder);
+    return d->currentOptions().outputSize;
+}
+
+void FFDecoder::setOutputSize(const QSize &size, Qt::AspectRatioMode mode) {
+    Q_D(FFDecoder);
+
+    QMutexLocker optionsLock(&d->optionsMutex);
+    d->options.outputSize = size;
+    d->options.aspectRatioMode = mode;
+}
@@ -30,9 +30,14 @@
 
 #include <QObject>
 #include <QScopedPointer>
+#include <QSize>
 
 #include "ffheaders.h"
 #include "ffframe.h"
+#include "ffvideoframe.h"
+#include "ffvideoframepool.h"
+#include "ffdecoderoptions.h"
+#include "ffstatistics.h"
 
 class FFDecoderPrivate;
 class FFDecoder : public QObject
@@ -40,9 +45,68 @@ class FFDecoder : public QObject
     Q_OBJECT
 public:
     explicit FFDecoder(AVFormatContext *context, QObject *parent = 0);
+    explicit FFDecoder(AVFormatContext *context, const FFDecoderOptions &options,
+                       QObject *parent = 0);
     virtual ~FFDecoder();
 
-    QList<FFFramePtr> decodeFrames(AVPacket *packet);
+    // With convert set to false video frames keep the decoded planes in
+    // FFVideoFrame::avFrame until convertFrame() is called, possibly from
+    // another thread.
+    QList<FFFramePtr> decodeFrames(AVPacket *packet, bool convert = true);
+    QList<FFFramePtr> drainFrames(bool convert = true);
+    bool convertFrame(const FFFramePtr &frame);
+    void flush();
+
+    // The audio and the video codec are independent, each one may be
+    // driven from a thread of its own through these. Packets of the other
+    // type are ignored.
+    QList<FFFramePtr> decodeFrames(FFFrame::FFFrameType type, AVPacket *packet, bool convert = true);
+    QList<FFFramePtr> drainFrames(FFFrame::FFFrameType type, bool convert = true);
+    void flush(FFFrame::FFFrameType type);
+
+    // Takes the streams of a reopened source, e.g. after a reconnect.
+    // False if their parameters differ from the ones the codecs were
+    // opened with, the decoder has to be created again then. Demuxing
+    // thread, packets are accepted from the new streams at once, the
+    // codecs only follow in applyReattach().
+    bool reattach(AVFormatContext *context);
+    // Decoding thread of the type, decodes its stream of the last
+    // reattach() from here on. Call it along with flush() before the
+    // first packet of the new source.
+    void applyReattach(FFFrame::FFFrameType type);
+
+    FFDecoderOptions options() const;
+    void setOptions(const FFDecoderOptions &options);
+
+    FFVideoFrame::PixelFormat outputFormat() const;
+    void setOutputFormat(FFVideoFrame::PixelFormat format);
+
+    QSize outputSize() const;
+    void setOutputSize(const QSize &size, Qt::AspectRatioMode mode = Qt::KeepAspectRatio);
+
+    // Demuxing thread.
+    bool acceptsPacket(const AVPacket *packet) const;
+    // Decoding thread.
+    bool isVideoPacket(const AVPacket *packet) const;
+
+    // Frames the video codec may skip, applied to the next packet.
+    AVDiscard skipFrame() const;
+    void setSkipFrame(AVDiscard discard);
+
+    // True if the video or the audio codec could be opened.
+    bool isOpen() const;
+
+    // Streams packets are accepted from, demuxing thread.
+    int videoStreamIndex() const;
+    int audioStreamIndex() const;
+
+    FFVideoFramePool framePool() const;
+    void setFramePool(const FFVideoFramePool &framePool);
+
+    // Decode, convert and copy timings are recorded into statistics when
+    // set, it has to outlive the decoder. Not owned.
+    FFStatistics *statistics() const;
+    void setStatistics(FFStatistics *statistics);
 
 signals:
 
@@ -0,0 +1,45 @@
+//
+//  ffdecoderoptions.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffdecoderoptions.h"
+
+FFDecoderOptions::FFDecoderOptions() :
+    outputFormat(FFVideoFrame::PixelFormatRGB888),
+    outputSize(),
+    aspectRatioMode(Qt::KeepAspectRatio),
+    scaleQuality(FFVideoFrame::ScaleQualityFast),
+    fastDecode(false),
+    threadCount(0),
+    threadType(ThreadTypeAuto),
+    lowDelay(false),
+    conversionThreads(1),
+    decodeAudio(false),
+    audioSampleRate(0),
+    audioChannels(0),
+    audioSampleFormat(FFAudioFrame::SampleFormatS16) {
+
+}
@@ -0,0 +1,79 @@
+//
+//  ffdecoderoptions.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFDECODEROPTIONS_H
+#define FFDECODEROPTIONS_H
+
+#include <QSize>
+
+#include "ffvideoframe.h"
+#include "ffaudioframe.h"
+
+struct FFDecoderOptions {
+    /** Codec threading */
+    typedef enum {
+        ThreadTypeAuto,             // frame and slice threading
+        ThreadTypeFrame,
+        ThreadTypeSlice
+    } ThreadType;
+
+    FFDecoderOptions();
+
+    FFVideoFrame::PixelFormat outputFormat;
+
+    // Output size, source size if empty. Not used for PixelFormatYUV.
+    QSize outputSize;
+    Qt::AspectRatioMode aspectRatioMode;
+    FFVideoFrame::ScaleQuality scaleQuality;
+
+    // Preview quality decoding: skips the loop filter and, when an output
+    // size is set, decodes at the lowest resolution that still covers it.
+    // Lowres is chosen when the codec is opened.
+    bool fastDecode;
+
+    // Codec threads, 0 picks one per core. Used when the codec is opened.
+    int threadCount;
+    ThreadType threadType;
+
+    // Low delay decoding for live sources, sets AV_CODEC_FLAG_LOW_DELAY
+    // and leaves out frame threading, each frame thread delays output by
+    // one frame. Used when the codec is opened.
+    bool lowDelay;
+
+    // Threads converting horizontal bands of a frame in parallel,
+    // 1 converts on the calling thread only, 0 picks one per core.
+    int conversionThreads;
+
+    // Audio is decoded and resampled to this output when decodeAudio is
+    // set, 0 keeps the source sample rate or channel count.
+    bool decodeAudio;
+    int audioSampleRate;
+    int audioChannels;
+    FFAudioFrame::SampleFormat audioSampleFormat;
+};
+
+#endif // FFDECODEROPTIONS_H
@@ -0,0 +1,302 @@
+//
+//  ffframeextractor.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffframeextractor.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QScopedPointer>
+
+#include <algorithm>
+
+#include "ffheaders.h"
+#include "ffdecoder.h"
+
+#define MAX_PACKETS_PER_POSITION    4096         // gives up on broken timestamps
+
+FFFrameExtractor::Request::Request() :
+    path(),
+    positions() {
+
+}
+
+FFFrameExtractor::Request::Request(const QString &path, const QList<double> &positions) :
+    path(path),
+    positions(positions) {
+
+}
+
+FFFrameExtractor::Result::Result() :
+    path(),
+    requestedPosition(0.0),
+    position(-1.0),
+    frame(),
+    imagePath() {
+
+}
+
+FFFrameExtractor::FFFrameExtractor(int threadCount) :
+    _scheduler(threadCount),
+    _settings(),
+    _generation(0),
+    _mutex(QMutex::NonRecursive) {
+
+    avcodec_register_all();
+    av_register_all();
+
+    // Files are the parallelism, not the codec threads.
+    _settings.options.threadCount = 1;
+    _settings.isAccurate = false;
+    _settings.imageFormat = "jpg";
+    _settings.imageQuality = -1;
+}
+
+FFFrameExtractor::~FFFrameExtractor() {
+    cancel();
+    _scheduler.waitForDone();
+}
+
+FFDecoderOptions FFFrameExtractor::options() const {
+    QMutexLocker locker(&_mutex);
+    return _settings.options;
+}
+
+void FFFrameExtractor::setOptions(const FFDecoderOptions &options) {
+    QMutexLocker locker(&_mutex);
+    _settings.options = options;
+}
+
+bool FFFrameExtractor::isAccurate() const {
+    QMutexLocker locker(&_mutex);
+    return _settings.isAccurate;
+}
+
+void FFFrameExtractor::setIsAccurate(bool isAccurate) {
+    QMutexLocker locker(&_mutex);
+    _settings.isAccurate = isAccurate;
+}
+
+QString FFFrameExtractor::outputDirectory() const {
+    QMutexLocker locker(&_mutex);
+    return _settings.outputDirectory;
+}
+
+void FFFrameExtractor::setOutputDirectory(const QString &directory,
+                                          const QByteArray &format, int quality) {
+    QMutexLocker locker(&_mutex);
+    _settings.outputDirectory = directory;
+    _settings.imageFormat = format;
+    _settings.imageQuality = quality;
+}
+
+FFFrameExtractor::Settings FFFrameExtractor::settings() const {
+    QMutexLocker locker(&_mutex);
+    return _settings;
+}
+
+void FFFrameExtractor::extract(const QList<Request> &requests, const Callback &callback) {
+    int generation = _generation.load();
+
+    for (int i = 0; i < requests.count(); i++) {
+        Request request = requests[i];
+        _scheduler.schedule([this, request, callback, generation]() {
+            extractFile(request, callback, generation);
+        });
+    }
+}
+
+void FFFrameExtractor::waitForDone() {
+    _scheduler.waitForDone();
+}
+
+void FFFrameExtractor::cancel() {
+    _generation.ref();
+}
+
+int FFFrameExtractor::threadCount() const {
+    return _scheduler.threadCount();
+}
+
+bool FFFrameExtractor::isCanceled(int generation) const {
+    return _generation.load() != generation;
+}
+
+int FFFrameExtractor::interruptCallback(void *opaque) {
+    InterruptContext *context = static_cast<InterruptContext *>(opaque);
+    return static_cast<int>(context->extractor->isCanceled(context->generation));
+}
+
+void FFFrameExtractor::extractFile(const Request &request, const Callback &callback, int generation) {
+    if (isCanceled(generation)) {
+        return;
+    }
+
+    Settings settings = this->settings();
+    settings.options.decodeAudio = false;
+
+    QList<double> positions = request.positions;
+    std::sort(positions.begin(), positions.end());
+
+    QList<Result> results;
+    for (int i = 0; i < positions.count(); i++) {
+        Result result;
+        result.path = request.path;
+        result.requestedPosition = positions[i];
+        results.append(result);
+    }
+
+    InterruptContext interruptContext;
+    interruptContext.extractor = this;
+    interruptContext.generation = generation;
+
+    AVFormatContext *formatContext = avformat_alloc_context();
+    formatContext->interrupt_callback.callback = interruptCallback;
+    formatContext->interrupt_callback.opaque = &interruptContext;
+
+    if (avformat_open_input(&formatContext, request.path.toUtf8().constData(), 0, 0) < 0) {
+        avformat_free_context(formatContext);
+        formatContext = 0;
+    }
+    else if (avformat_find_stream_info(formatContext, NULL) < 0) {
+        avformat_close_input(&formatContext);
+    }
+
+    QScopedPointer<FFDecoder> decoder;
+    if (formatContext) {
+        decoder.reset(new FFDecoder(formatContext, settings.options));
+    }
+
+    int streamIndex = decoder ? decoder->videoStreamIndex() : -1;
+
+    // Positions count from the start of the file, frames carry the stamps
+    // of the stream, e.g. MPEG-TS rarely starts at 0.
+    double startTime = 0.0;
+    if (formatContext && formatContext->start_time != AV_NOPTS_VALUE) {
+        startTime = (double)formatContext->start_time / (double)AV_TIME_BASE;
+    }
+
+    for (int i = 0; i < results.count() && streamIndex >= 0 && !isCanceled(generation); i++) {
+        Result &result = results[i];
+        double target = startTime + result.requestedPosition;
+        int64_t timestamp = static_cast<int64_t>(target * AV_TIME_BASE);
+
+        // The keyframe at or before the position.
+        if (avformat_seek_file(formatContext, -1, INT64_MIN, timestamp, timestamp, 0) < 0) {
+            continue;
+        }
+
+        decoder->flush();
+
+        // Without accuracy nothing but the keyframe is decoded.
+        decoder->setSkipFrame(settings.isAccurate ? AVDISCARD_DEFAULT : AVDISCARD_NONKEY);
+
+        FFVideoFramePtr candidate;
+        bool isEndOfStream = false;
+
+        for (int packets = 0; !result.frame && packets < MAX_PACKETS_PER_POSITION; packets++) {
+            AVPacket packet;
+            av_init_packet(&packet);
+            packet.data = NULL;
+            packet.size = 0;
+
+            QList<FFFramePtr> frames;
+            if (av_read_frame(formatContext, &packet) < 0) {
+                isEndOfStream = true;
+                frames = decoder->drainFrames(false);
+            }
+            else if (packet.stream_index == streamIndex) {
+                frames = decoder->decodeFrames(&packet, false);
+            }
+
+            av_packet_unref(&packet);
+
+            for (int j = 0; j < frames.count() && !result.frame; j++) {
+                if (frames[j]->getFrameType() != FFFrame::FFFrameTypeVideo) {
+                    continue;
+                }
+
+                candidate = qSharedPointerCast<FFVideoFrame>(frames[j]);
+
+                // The frame showing at the position.
+                bool isAtPosition = candidate->position + candidate->frameDelayMsec / 1000.0 >
+                                    target;
+
+                if (!settings.isAccurate || isAtPosition) {
+                    result.frame = candidate;
+                }
+            }
+
+            if (isEndOfStream) {
+                break;
+            }
+        }
+
+        // Past the last frame, the last one decoded.
+        if (!result.frame && isEndOfStream) {
+            result.frame = candidate;
+        }
+
+        // Only the chosen frame is converted.
+        if (result.frame && !decoder->convertFrame(result.frame)) {
+            result.frame.clear();
+        }
+
+        if (!result.frame) {
+            continue;
+        }
+
+        result.position = result.frame->position - startTime;
+
+        if (!settings.outputDirectory.isEmpty() && result.frame->image) {
+            QString fileName = QString("%1_%2.%3")
+                    .arg(QFileInfo(request.path).completeBaseName())
+                    .arg(qRound64(result.requestedPosition * 1000.0))
+                    .arg(QString::fromLatin1(settings.imageFormat));
+            QString imagePath = QDir(settings.outputDirectory).filePath(fileName);
+
+            if (result.frame->image->save(imagePath, settings.imageFormat.constData(),
+                                          settings.imageQuality)) {
+                result.imagePath = imagePath;
+            }
+        }
+    }
+
+    // Decoder first, it refers to the streams of the context.
+    decoder.reset();
+    if (formatContext) {
+        avformat_close_input(&formatContext);
+    }
+
+    if (!callback || isCanceled(generation)) {
+        return;
+    }
+
+    for (int i = 0; i < results.count(); i++) {
+        callback(results[i]);
+    }
+}
@@ -0,0 +1,135 @@
+//
+//  ffframeextractor.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFFRAMEEXTRACTOR_H
+#define FFFRAMEEXTRACTOR_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+#include <functional>
+
+#include "ffvideoframe.h"
+#include "ffdecoderoptions.h"
+#include "ffscheduler.h"
+
+/**
+ * Headless batch extraction of video frames, e.g. thumbnails and poster
+ * frames of many recordings.
+ *
+ * Every file is one task on a work-stealing FFScheduler: it is opened
+ * once, seeks to the keyframe before each position and only the chosen
+ * frames are converted. Results go to a callback on the worker threads,
+ * and are written as images when an output directory is set.
+ */
+class FFFrameExtractor {
+public:
+    struct Request {
+        Request();
+        Request(const QString &path, const QList<double> &positions);
+
+        QString         path;
+        QList<double>   positions;      // seconds
+    };
+
+    struct Result {
+        Result();
+
+        QString         path;
+        double          requestedPosition;
+        double          position;       // of the frame, -1 if none was found
+        FFVideoFramePtr frame;          // null if none was found
+        QString         imagePath;      // written image, empty if not written
+    };
+
+    typedef std::function<void(const Result &)> Callback;
+
+    // 0 starts one worker per core.
+    explicit FFFrameExtractor(int threadCount = 0);
+    // Cancels what is still queued.
+    ~FFFrameExtractor();
+
+    // Output of the frames. fastDecode with an output size decodes at a
+    // lower resolution, codec threads default to one per file.
+    FFDecoderOptions options() const;
+    void setOptions(const FFDecoderOptions &options);
+
+    // Accurate extraction decodes forward from the keyframe to the frame
+    // at the position, otherwise the keyframe itself is taken.
+    bool isAccurate() const;
+    void setIsAccurate(bool isAccurate);
+
+    // Frames are also written as "<file>_<msecs>.<format>" to the
+    // directory, empty writes nothing. Quality as in QImage::save().
+    QString outputDirectory() const;
+    void setOutputDirectory(const QString &directory,
+                            const QByteArray &format = "jpg", int quality = -1);
+
+    // Returns at once. The callback is called once per position, in the
+    // order of the positions within a file, on the worker threads.
+    void extract(const QList<Request> &requests, const Callback &callback = Callback());
+
+    void waitForDone();
+    // Drops what is queued and interrupts what is running.
+    void cancel();
+
+    int threadCount() const;
+
+private:
+    Q_DISABLE_COPY(FFFrameExtractor)
+
+    struct InterruptContext {
+        const FFFrameExtractor  *extractor;
+        int                     generation;
+    };
+
+    void extractFile(const Request &request, const Callback &callback, int generation);
+    bool isCanceled(int generation) const;
+    static int interruptCallback(void *opaque);
+
+    struct Settings {
+        FFDecoderOptions    options;
+        bool                isAccurate;
+        QString             outputDirectory;
+        QByteArray          imageFormat;
+        int                 imageQuality;
+    };
+
+    Settings settings() const;
+
+    FFScheduler          _scheduler;
+    Settings             _settings;
+
+    // Bumped by cancel(), tasks of an older generation stop.
+    QAtomicInt           _generation;
+
+    mutable QMutex       _mutex;
+};
+
+#endif // FFFRAMEEXTRACTOR_H
@@ -0,0 +1,145 @@
+//
+//  ffframequeue.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffframequeue.h"
+
+FFFrameQueue::FFFrameQueue(int maxFrames) :
+    _maxFrames(qMax(1, maxFrames)),
+    _isFinished(false),
+    _isAborted(false),
+    _mutex(QMutex::NonRecursive) {
+
+}
+
+FFFrameQueue::~FFFrameQueue() {
+
+}
+
+bool FFFrameQueue::put(const FFFramePtr &frame, int serial, qint64 received) {
+    QMutexLocker locker(&_mutex);
+
+    while (!_isAborted && _frames.count() >= _maxFrames) {
+        _notFull.wait(&_mutex);
+    }
+
+    if (_isAborted) {
+        return false;
+    }
+
+    QueuedFrame queued;
+    queued.frame = frame;
+    queued.serial = serial;
+    queued.received = received;
+    _frames.enqueue(queued);
+    _notEmpty.wakeOne();
+
+    return true;
+}
+
+bool FFFrameQueue::get(FFFramePtr *frame, int *serial, qint64 *received) {
+    QMutexLocker locker(&_mutex);
+
+    while (!_isAborted && !_isFinished && _frames.isEmpty()) {
+        _notEmpty.wait(&_mutex);
+    }
+
+    if (_isAborted || _frames.isEmpty()) {
+        return false;
+    }
+
+    QueuedFrame queued = _frames.dequeue();
+    *frame = queued.frame;
+    if (serial) {
+        *serial = queued.serial;
+    }
+    if (received) {
+        *received = queued.received;
+    }
+    _notFull.wakeOne();
+
+    return true;
+}
+
+void FFFrameQueue::flush() {
+    QMutexLocker locker(&_mutex);
+    _frames.clear();
+    _notFull.wakeAll();
+}
+
+void FFFrameQueue::finish() {
+    QMutexLocker locker(&_mutex);
+    _isFinished = true;
+    _notEmpty.wakeAll();
+}
+
+void FFFrameQueue::abort() {
+    QMutexLocker locker(&_mutex);
+    _isAborted = true;
+    _notEmpty.wakeAll();
+    _notFull.wakeAll();
+}
+
+void FFFrameQueue::reset() {
+    QMutexLocker locker(&_mutex);
+    _frames.clear();
+    _isFinished = false;
+    _isAborted = false;
+}
+
+int FFFrameQueue::count() const {
+    QMutexLocker locker(&_mutex);
+    return _frames.count();
+}
+
+int FFFrameQueue::count(FFFrame::FFFrameType type) const {
+    QMutexLocker locker(&_mutex);
+
+    int typeCount = 0;
+    for (int i = 0; i < _frames.count(); i++) {
+        if (_frames[i].frame->getFrameType() == type) {
+            typeCount++;
+        }
+    }
+
+    return typeCount;
+}
+
+bool FFFrameQueue::isAborted() const {
+    QMutexLocker locker(&_mutex);
+    return _isAborted;
+}
+
+int FFFrameQueue::maxFrames() const {
+    QMutexLocker locker(&_mutex);
+    return _maxFrames;
+}
+
+void FFFrameQueue::setMaxFrames(int maxFrames) {
+    QMutexLocker locker(&_mutex);
+    _maxFrames = qMax(1, maxFrames);
+    _notFull.wakeAll();
+}
@@ -0,0 +1,83 @@
+//
+//  ffframequeue.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFFRAMEQUEUE_H
+#define FFFRAMEQUEUE_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+#include "ffframe.h"
+
+/**
+ * Bounded blocking queue of decoded frames between pipeline stages.
+ * Same semantics as FFPacketQueue.
+ */
+class FFFrameQueue {
+public:
+    explicit FFFrameQueue(int maxFrames = 4);
+    ~FFFrameQueue();
+
+    // False if the queue was aborted. The serial and the receive time
+    // are passed through to get().
+    bool put(const FFFramePtr &frame, int serial = 0, qint64 received = 0);
+    // False if the queue was aborted or finished and empty.
+    bool get(FFFramePtr *frame, int *serial = 0, qint64 *received = 0);
+
+    void flush();
+    void finish();
+    void abort();
+    void reset();
+
+    int count() const;
+    int count(FFFrame::FFFrameType type) const;
+    bool isAborted() const;
+
+    int maxFrames() const;
+    void setMaxFrames(int maxFrames);
+
+private:
+    Q_DISABLE_COPY(FFFrameQueue)
+
+    struct QueuedFrame {
+        FFFramePtr  frame;
+        int         serial;
+        qint64      received;
+    };
+
+    QQueue<QueuedFrame>  _frames;
+    int                  _maxFrames;
+    bool                 _isFinished;
+    bool                 _isAborted;
+
+    mutable QMutex       _mutex;
+    QWaitCondition       _notEmpty;
+    QWaitCondition       _notFull;
+};
+
+#endif // FFFRAMEQUEUE_H
@@ -0,0 +1,78 @@
+//
+//  ffframering.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffframering.h"
+
+#define FRESH_FLAG                  0x4
+#define INDEX_MASK                  0x3
+
+FFFrameRing::FFFrameRing() :
+    _middle(1),
+    _back(0),
+    _front(2),
+    _overwritten(0) {
+
+}
+
+bool FFFrameRing::push(const FFVideoFramePtr &frame) {
+    _slots[_back] = frame;
+
+    int previous = _middle.fetchAndStoreAcquireRelease(_back | FRESH_FLAG);
+    _back = previous & INDEX_MASK;
+
+    // Drop the replaced frame right away, the slot is ours now.
+    _slots[_back].clear();
+
+    if (previous & FRESH_FLAG) {
+        _overwritten.ref();
+        return false;
+    }
+
+    return true;
+}
+
+FFVideoFramePtr FFFrameRing::acquire() {
+    if (!(_middle.loadAcquire() & FRESH_FLAG)) {
+        return FFVideoFramePtr();
+    }
+
+    int previous = _middle.fetchAndStoreAcquireRelease(_front);
+    _front = previous & INDEX_MASK;
+
+    FFVideoFramePtr frame = _slots[_front];
+    _slots[_front].clear();
+
+    return frame;
+}
+
+bool FFFrameRing::hasFrame() const {
+    return _middle.loadAcquire() & FRESH_FLAG;
+}
+
+int FFFrameRing::overwrittenCount() const {
+    return _overwritten.load();
+}
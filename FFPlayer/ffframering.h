@@ -0,0 +1,66 @@
+//
+//  ffframering.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFFRAMERING_H
+#define FFFRAMERING_H
+
+#include <QAtomicInt>
+
+#include "ffvideoframe.h"
+
+/**
+ * Lock-free single-producer/single-consumer frame ring, latest frame wins.
+ *
+ * Three slots are rotated through one atomic index: the producer owns the
+ * back slot, the consumer the front slot, and the middle slot holds the
+ * newest published frame. Publishing over a frame the consumer has not
+ * taken yet replaces it, so at most three frames are ever held.
+ */
+class FFFrameRing {
+public:
+    explicit FFFrameRing();
+
+    // Producer side. True if the ring had no pending frame before.
+    bool push(const FFVideoFramePtr &frame);
+
+    // Consumer side. Null if nothing was published since the last call.
+    FFVideoFramePtr acquire();
+
+    bool hasFrame() const;
+    int overwrittenCount() const;
+
+private:
+    Q_DISABLE_COPY(FFFrameRing)
+
+    FFVideoFramePtr      _slots[3];
+    QAtomicInt           _middle;       // slot index, FRESH_FLAG when unread
+    int                  _back;         // owned by the producer
+    int                  _front;        // owned by the consumer
+    QAtomicInt           _overwritten;
+};
+
+#endif // FFFRAMERING_H
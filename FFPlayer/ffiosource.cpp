@@ -0,0 +1,345 @@
+//
+//  ffiosource.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffiosource.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QFileDevice>
+#include <QIODevice>
+#include <QThread>
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+#define IO_BUFFER_SIZE              262144       // bytes, 256 KB
+#define DEVICE_READ_WAIT            100          // msecs
+#define DEVICE_POLL_INTERVAL        10           // msecs, devices without waitForReadyRead()
+
+/*
+ * FFMemorySource, a byte array or a mapped file.
+ */
+class FFMemorySource : public FFIOSource {
+public:
+    explicit FFMemorySource(const QByteArray &data);
+    explicit FFMemorySource(const QString &path);
+    virtual ~FFMemorySource();
+
+    bool isValid() const;
+    int read(uint8_t *buffer, int size);
+    qint64 seek(qint64 position);
+    qint64 position() const;
+    qint64 size() const;
+    QString filePath() const;
+
+private:
+    QByteArray           _data;         // keeps shared data alive
+    QFile                _file;         // mapped file
+    const uchar         *_begin;
+    qint64               _size;
+    qint64               _position;
+};
+
+FFMemorySource::FFMemorySource(const QByteArray &data) :
+    _data(data),
+    _begin(reinterpret_cast<const uchar *>(_data.constData())),
+    _size(_data.size()),
+    _position(0) {
+
+}
+
+FFMemorySource::FFMemorySource(const QString &path) :
+    _file(path),
+    _begin(0),
+    _size(0),
+    _position(0) {
+
+    if (!_file.open(QIODevice::ReadOnly) || _file.size() <= 0) {
+        return;
+    }
+
+    uchar *mapped = _file.map(0, _file.size());
+    if (!mapped) {
+        return;
+    }
+
+#ifdef Q_OS_UNIX
+    // Demuxing reads front to back, let the kernel read ahead.
+    madvise(mapped, static_cast<size_t>(_file.size()), MADV_SEQUENTIAL);
+#endif
+
+    _begin = mapped;
+    _size = _file.size();
+}
+
+FFMemorySource::~FFMemorySource() {
+    if (_file.isOpen() && _begin) {
+        _file.unmap(const_cast<uchar *>(_begin));
+    }
+}
+
+bool FFMemorySource::isValid() const {
+    return _begin != 0;
+}
+
+int FFMemorySource::read(uint8_t *buffer, int size) {
+    int length = static_cast<int>(qMin<qint64>(size, _size - _position));
+    if (length <= 0) {
+        return 0;
+    }
+
+    memcpy(buffer, _begin + _position, length);
+    _position += length;
+
+    return length;
+}
+
+qint64 FFMemorySource::seek(qint64 position) {
+    if (position < 0 || position > _size) {
+        return -1;
+    }
+
+    _position = position;
+    return _position;
+}
+
+qint64 FFMemorySource::position() const {
+    return _position;
+}
+
+qint64 FFMemorySource::size() const {
+    return _size;
+}
+
+QString FFMemorySource::filePath() const {
+    return _file.fileName();
+}
+
+/*
+ * FFDeviceSource
+ */
+class FFDeviceSource : public FFIOSource {
+public:
+    explicit FFDeviceSource(QIODevice *device);
+
+    bool isValid() const;
+    int read(uint8_t *buffer, int size);
+    qint64 seek(qint64 position);
+    qint64 position() const;
+    qint64 size() const;
+    bool isSequential() const;
+
+private:
+    QIODevice            *_device;
+};
+
+static bool isReadableFromCurrentThread(const QIODevice *device) {
+    // Files and buffers keep no state bound to a thread. Sockets, processes
+    // or network replies are only safe to read on the thread they live in.
+    return qobject_cast<const QFileDevice *>(device) || qobject_cast<const QBuffer *>(device) ||
+           device->thread() == QThread::currentThread();
+}
+
+FFDeviceSource::FFDeviceSource(QIODevice *device) :
+    _device(device) {
+
+}
+
+bool FFDeviceSource::isValid() const {
+    return _device && _device->isReadable();
+}
+
+int FFDeviceSource::read(uint8_t *buffer, int size) {
+    Q_ASSERT_X(isReadableFromCurrentThread(_device), "FFDeviceSource::read",
+               "device has to be a file, a buffer or live in the decoding thread");
+
+    forever {
+        qint64 length = _device->read(reinterpret_cast<char *>(buffer), size);
+        if (length != 0 || !_device->isSequential()) {
+            return static_cast<int>(length);
+        }
+
+        // Sequential devices wait for more data until they are closed,
+        // or until the player gives up on the read. Files read blocking,
+        // at their end, e.g. a pipe whose writer is gone, nothing follows.
+        if (!_device->isOpen() || (qobject_cast<QFileDevice *>(_device) && _device->atEnd())) {
+            return 0;
+        }
+
+        if (isInterrupted()) {
+            return AVERROR_EXIT;
+        }
+
+        if (!_device->waitForReadyRead(DEVICE_READ_WAIT) && _device->bytesAvailable() == 0) {
+            QThread::msleep(DEVICE_POLL_INTERVAL);
+        }
+    }
+}
+
+qint64 FFDeviceSource::seek(qint64 position) {
+    Q_ASSERT_X(isReadableFromCurrentThread(_device), "FFDeviceSource::seek",
+               "device has to be a file, a buffer or live in the decoding thread");
+
+    if (_device->isSequential() || !_device->seek(position)) {
+        return -1;
+    }
+
+    return _device->pos();
+}
+
+qint64 FFDeviceSource::position() const {
+    return _device->pos();
+}
+
+qint64 FFDeviceSource::size() const {
+    return _device->isSequential() ? -1 : _device->size();
+}
+
+bool FFDeviceSource::isSequential() const {
+    return _device->isSequential();
+}
+
+/*
+ * FFIOSource
+ */
+FFIOSource::FFIOSource() {
+    _interrupt.callback = 0;
+    _interrupt.opaque = 0;
+}
+
+FFIOSource::~FFIOSource() {
+
+}
+
+QSharedPointer<FFIOSource> FFIOSource::fromData(const QByteArray &data) {
+    return QSharedPointer<FFIOSource>(new FFMemorySource(data));
+}
+
+QSharedPointer<FFIOSource> FFIOSource::fromMappedFile(const QString &path) {
+    return QSharedPointer<FFIOSource>(new FFMemorySource(path));
+}
+
+QSharedPointer<FFIOSource> FFIOSource::fromDevice(QIODevice *device) {
+    return QSharedPointer<FFIOSource>(new FFDeviceSource(device));
+}
+
+AVIOContext *FFIOSource::createContext(const AVIOInterruptCB &interrupt) {
+    if (!isValid()) {
+        return 0;
+    }
+
+    // Reopens, e.g. after a stale probe, start over.
+    if (!isSequential() && seek(0) < 0) {
+        return 0;
+    }
+
+    _interrupt = interrupt;
+
+    unsigned char *buffer = static_cast<unsigned char *>(av_malloc(IO_BUFFER_SIZE));
+    if (!buffer) {
+        return 0;
+    }
+
+    AVIOContext *context = avio_alloc_context(buffer, IO_BUFFER_SIZE, 0, this,
+                                              readPacket, 0, seekPacket);
+    if (!context) {
+        av_free(buffer);
+        return 0;
+    }
+
+    if (isSequential()) {
+        context->seekable = 0;
+    }
+
+    return context;
+}
+
+void FFIOSource::freeContext(AVIOContext *context) {
+    if (!context) {
+        return;
+    }
+
+    // The buffer may have been replaced by FFmpeg, free the current one.
+    av_freep(&context->buffer);
+    av_free(context);
+}
+
+bool FFIOSource::isSequential() const {
+    return false;
+}
+
+QString FFIOSource::filePath() const {
+    return QString();
+}
+
+bool FFIOSource::isInterrupted() const {
+    return _interrupt.callback && _interrupt.callback(_interrupt.opaque);
+}
+
+int FFIOSource::readPacket(void *opaque, uint8_t *buffer, int size) {
+    FFIOSource *source = static_cast<FFIOSource *>(opaque);
+
+    int length = source->read(buffer, size);
+    if (length == 0) {
+        return AVERROR_EOF;
+    }
+
+    return length < 0 && length != AVERROR_EXIT ? AVERROR(EIO) : length;
+}
+
+int64_t FFIOSource::seekPacket(void *opaque, int64_t offset, int whence) {
+    FFIOSource *source = static_cast<FFIOSource *>(opaque);
+
+    if (whence & AVSEEK_SIZE) {
+        qint64 size = source->size();
+        return size >= 0 ? size : AVERROR(ENOSYS);
+    }
+
+    qint64 position = offset;
+    switch (whence & ~AVSEEK_FORCE) {
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        position += source->position();
+        break;
+    case SEEK_END:
+        if (source->size() < 0) {
+            return AVERROR(ENOSYS);
+        }
+        position += source->size();
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    qint64 result = source->seek(position);
+    return result >= 0 ? result : AVERROR(EIO);
+}
@@ -0,0 +1,99 @@
+//
+//  ffiosource.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFIOSOURCE_H
+#define FFIOSOURCE_H
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QString>
+
+#include "ffheaders.h"
+
+class QIODevice;
+
+/**
+ * Input read through a custom AVIOContext instead of a URL.
+ *
+ * Content already held by the application, e.g. decrypted segments or
+ * received buffers, is demuxed from memory, from a memory-mapped file or
+ * from a QIODevice without a round-trip through temporary files. Reads
+ * go through large av_malloc() aligned buffers, random access sources
+ * are seekable. The player reads the source from its decoding thread.
+ * Custom sources are not reconnected, a sequential one can not be read
+ * from its start again.
+ */
+class FFIOSource {
+public:
+    virtual ~FFIOSource();
+
+    // The data is shared, not copied.
+    static QSharedPointer<FFIOSource> fromData(const QByteArray &data);
+    // Local file mapped into memory, read straight from the page cache.
+    static QSharedPointer<FFIOSource> fromMappedFile(const QString &path);
+    // Not owned, has to stay open while the player reads it. Read from
+    // the decoding thread, so it has to be a file or a buffer, or live in
+    // that thread. Sockets, processes and network replies of another
+    // thread are not thread-safe, wrap them in an FFIOSource instead.
+    static QSharedPointer<FFIOSource> fromDevice(QIODevice *device);
+
+    // Context reading the source from its start, 0 on failure. Reads
+    // waiting for data stop when the interrupt callback asks to.
+    AVIOContext *createContext(const AVIOInterruptCB &interrupt);
+    static void freeContext(AVIOContext *context);
+
+    virtual bool isValid() const = 0;
+    // Bytes read, 0 at the end of the source, negative on errors.
+    virtual int read(uint8_t *buffer, int size) = 0;
+    // New position, negative on errors or when not seekable.
+    virtual qint64 seek(qint64 position) = 0;
+    virtual qint64 position() const = 0;
+    // -1 if unknown.
+    virtual qint64 size() const = 0;
+    virtual bool isSequential() const;
+
+    // Local file behind the source, if any. Keyframe index sidecars are
+    // kept for it.
+    virtual QString filePath() const;
+
+protected:
+    explicit FFIOSource();
+
+    bool isInterrupted() const;
+
+private:
+    Q_DISABLE_COPY(FFIOSource)
+
+    static int readPacket(void *opaque, uint8_t *buffer, int size);
+    static int64_t seekPacket(void *opaque, int64_t offset, int whence);
+
+    AVIOInterruptCB      _interrupt;
+};
+
+typedef QSharedPointer<FFIOSource> FFIOSourcePtr;
+
+#endif // FFIOSOURCE_H
@@ -0,0 +1,203 @@
+//
+//  ffkeyframeindex.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffkeyframeindex.h"
+
+#include <QSaveFile>
+#include <QDateTime>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#define INDEX_MAGIC                 "FFKI"
+#define INDEX_VERSION               1
+#define INDEX_FLAG_COMPLETE         0x1
+
+struct IndexHeader {
+    char        magic[4];
+    quint32     version;
+    quint32     flags;
+    quint32     reserved;
+    qint64      sourceSize;
+    qint64      sourceModified;     // msecs since epoch
+    qint64      count;
+};
+
+static bool entryBefore(qint64 timestamp, const FFKeyframeIndex::Entry &entry) {
+    return timestamp < entry.timestamp;
+}
+
+FFKeyframeIndex::FFKeyframeIndex() :
+    _mapped(0),
+    _mappedCount(0),
+    _isComplete(false) {
+
+}
+
+FFKeyframeIndex::~FFKeyframeIndex() {
+    clear();
+}
+
+bool FFKeyframeIndex::load(const QString &path, const QFileInfo &source) {
+    clear();
+
+    _file.setFileName(path);
+    if (!_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    qint64 size = _file.size();
+    if (size < static_cast<qint64>(sizeof(IndexHeader))) {
+        clear();
+        return false;
+    }
+
+    uchar *data = _file.map(0, size);
+    if (!data) {
+        clear();
+        return false;
+    }
+
+    // Written in native byte order, a foreign sidecar fails the version check.
+    const IndexHeader *header = reinterpret_cast<const IndexHeader *>(data);
+    bool isValid = memcmp(header->magic, INDEX_MAGIC, 4) == 0 &&
+            header->version == INDEX_VERSION &&
+            header->sourceSize == source.size() &&
+            header->sourceModified == source.lastModified().toMSecsSinceEpoch() &&
+            header->count >= 0 && header->count <= INT_MAX &&
+            size == static_cast<qint64>(sizeof(IndexHeader) + header->count * sizeof(Entry));
+
+    if (!isValid) {
+        clear();
+        return false;
+    }
+
+    _mapped = reinterpret_cast<const Entry *>(data + sizeof(IndexHeader));
+    _mappedCount = static_cast<int>(header->count);
+    _isComplete = header->flags & INDEX_FLAG_COMPLETE;
+
+    return true;
+}
+
+bool FFKeyframeIndex::save(const QString &path, const QFileInfo &source) const {
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, 4);
+    header.version = INDEX_VERSION;
+    header.flags = _isComplete ? INDEX_FLAG_COMPLETE : 0;
+    header.sourceSize = source.size();
+    header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+    header.count = count();
+
+    // Readers never see a partly written sidecar.
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(entries()), count() * sizeof(Entry));
+
+    return file.commit();
+}
+
+void FFKeyframeIndex::clear() {
+    if (_file.isOpen()) {
+        _file.close();      // unmaps as well
+    }
+
+    _entries.clear();
+    _mapped = 0;
+    _mappedCount = 0;
+    _isComplete = false;
+}
+
+void FFKeyframeIndex::detach() {
+    if (!_mapped) {
+        return;
+    }
+
+    QVector<Entry> entries(_mappedCount);
+    std::copy(_mapped, _mapped + _mappedCount, entries.begin());
+    bool isComplete = _isComplete;
+
+    clear();
+    _entries = entries;
+    _isComplete = isComplete;
+}
+
+void FFKeyframeIndex::append(qint64 timestamp, qint64 position) {
+    // A loaded sidecar is read-only until detach().
+    if (_mapped) {
+        return;
+    }
+
+    if (!_entries.isEmpty() && timestamp <= _entries.last().timestamp) {
+        return;
+    }
+
+    Entry entry;
+    entry.timestamp = timestamp;
+    entry.position = position;
+    _entries.append(entry);
+}
+
+bool FFKeyframeIndex::find(qint64 timestamp, qint64 *position) const {
+    int entryCount = count();
+    if (entryCount == 0 || (!_isComplete && timestamp > lastTimestamp())) {
+        return false;
+    }
+
+    const Entry *begin = entries();
+    const Entry *end = begin + entryCount;
+    const Entry *next = std::upper_bound(begin, end, timestamp, entryBefore);
+
+    *position = next == begin ? begin->position : (next - 1)->position;
+    return true;
+}
+
+int FFKeyframeIndex::count() const {
+    return _mapped ? _mappedCount : _entries.count();
+}
+
+qint64 FFKeyframeIndex::lastTimestamp() const {
+    int entryCount = count();
+    return entryCount > 0 ? entries()[entryCount - 1].timestamp : 0;
+}
+
+bool FFKeyframeIndex::isComplete() const {
+    return _isComplete;
+}
+
+void FFKeyframeIndex::setIsComplete(bool isComplete) {
+    _isComplete = isComplete;
+}
+
+const FFKeyframeIndex::Entry *FFKeyframeIndex::entries() const {
+    return _mapped ? _mapped : _entries.constData();
+}
@@ -0,0 +1,85 @@
+//
+//  ffkeyframeindex.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFKEYFRAMEINDEX_H
+#define FFKEYFRAMEINDEX_H
+
+#include <QFile>
+#include <QVector>
+#include <QFileInfo>
+
+/**
+ * Keyframe index of a local file, timestamp to byte offset.
+ *
+ * Entries are appended in timestamp order by a linear pass over the file
+ * and saved to a versioned sidecar file. A loaded sidecar is memory-mapped and searched
+ * in place, it is rejected when the version, size or modification time
+ * of the source do not match.
+ */
+class FFKeyframeIndex {
+public:
+    explicit FFKeyframeIndex();
+    ~FFKeyframeIndex();
+
+    bool load(const QString &path, const QFileInfo &source);
+    bool save(const QString &path, const QFileInfo &source) const;
+    void clear();
+    // Copies a loaded sidecar into memory, appends continue after it.
+    void detach();
+
+    // Timestamps in AV_TIME_BASE units, out of order entries are ignored.
+    void append(qint64 timestamp, qint64 position);
+
+    // Byte offset of the last keyframe at or before the timestamp. False
+    // past the end of an incomplete index.
+    bool find(qint64 timestamp, qint64 *position) const;
+
+    int count() const;
+    qint64 lastTimestamp() const;
+
+    // Set once the whole source was indexed.
+    bool isComplete() const;
+    void setIsComplete(bool isComplete);
+
+    struct Entry {
+        qint64      timestamp;
+        qint64      position;
+    };
+
+private:
+    Q_DISABLE_COPY(FFKeyframeIndex)
+
+    const Entry *entries() const;
+
+    QVector<Entry>       _entries;      // built or detached
+    QFile                _file;         // mapped sidecar
+    const Entry         *_mapped;
+    int                  _mappedCount;
+    bool                 _isComplete;
+};
+
+#endif // FFKEYFRAMEINDEX_H
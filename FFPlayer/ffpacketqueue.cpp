@@ -0,0 +1,204 @@
+//
+//  ffpacketqueue.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffpacketqueue.h"
+
+FFPacketQueue::FFPacketQueue(int maxPackets, int maxBytes) :
+    _bytes(0),
+    _serial(0),
+    _maxPackets(qMax(1, maxPackets)),
+    _maxBytes(qMax(1, maxBytes)),
+    _isFinished(false),
+    _isAborted(false),
+    _isPutInterrupted(false),
+    _mutex(QMutex::NonRecursive) {
+
+}
+
+FFPacketQueue::~FFPacketQueue() {
+    flush();
+}
+
+bool FFPacketQueue::put(AVPacket *packet, qint64 received) {
+    QueuedPacket queued;
+    av_init_packet(&queued.packet);
+
+    // Demuxers may return packets that point into their own buffers.
+    if (packet->buf) {
+        av_packet_move_ref(&queued.packet, packet);
+    }
+    else if (av_packet_ref(&queued.packet, packet) < 0) {
+        return false;
+    }
+
+    QMutexLocker locker(&_mutex);
+
+    // Always accept at least one packet, so a single large one can pass.
+    while (!_isAborted && !_isPutInterrupted && isFullLocked()) {
+        _notFull.wait(&_mutex);
+    }
+
+    if (_isAborted) {
+        av_packet_unref(&queued.packet);
+        return false;
+    }
+
+    // The caller decides, e.g. keeps it in case the pending seek fails.
+    if (_isPutInterrupted && isFullLocked()) {
+        av_packet_unref(packet);
+        av_packet_move_ref(packet, &queued.packet);
+        return false;
+    }
+
+    queued.serial = _serial;
+    queued.received = received;
+    _packets.enqueue(queued);
+    _bytes += queued.packet.size;
+    _notEmpty.wakeOne();
+
+    return true;
+}
+
+bool FFPacketQueue::isFullLocked() const {
+    return !_packets.isEmpty() && (_packets.count() >= _maxPackets || _bytes >= _maxBytes);
+}
+
+bool FFPacketQueue::get(AVPacket *packet, int *serial, qint64 *received) {
+    QMutexLocker locker(&_mutex);
+
+    while (!_isAborted && !_isFinished && _packets.isEmpty()) {
+        _notEmpty.wait(&_mutex);
+    }
+
+    return takeLocked(packet, serial, received);
+}
+
+bool FFPacketQueue::tryGet(AVPacket *packet, int *serial, qint64 *received) {
+    QMutexLocker locker(&_mutex);
+    return takeLocked(packet, serial, received);
+}
+
+bool FFPacketQueue::takeLocked(AVPacket *packet, int *serial, qint64 *received) {
+    if (_isAborted || _packets.isEmpty()) {
+        return false;
+    }
+
+    QueuedPacket queued = _packets.dequeue();
+    _bytes -= queued.packet.size;
+    av_packet_move_ref(packet, &queued.packet);
+    if (serial) {
+        *serial = queued.serial;
+    }
+    if (received) {
+        *received = queued.received;
+    }
+    _notFull.wakeOne();
+
+    return true;
+}
+
+void FFPacketQueue::flush() {
+    QMutexLocker locker(&_mutex);
+
+    while (!_packets.isEmpty()) {
+        QueuedPacket queued = _packets.dequeue();
+        av_packet_unref(&queued.packet);
+    }
+
+    _bytes = 0;
+    _serial++;
+    _notFull.wakeAll();
+}
+
+void FFPacketQueue::finish() {
+    QMutexLocker locker(&_mutex);
+    _isFinished = true;
+    _notEmpty.wakeAll();
+}
+
+void FFPacketQueue::abort() {
+    QMutexLocker locker(&_mutex);
+    _isAborted = true;
+    _notEmpty.wakeAll();
+    _notFull.wakeAll();
+}
+
+void FFPacketQueue::reset() {
+    flush();
+
+    QMutexLocker locker(&_mutex);
+    _isFinished = false;
+    _isAborted = false;
+}
+
+void FFPacketQueue::setIsPutInterrupted(bool isPutInterrupted) {
+    QMutexLocker locker(&_mutex);
+    _isPutInterrupted = isPutInterrupted;
+    _notFull.wakeAll();
+}
+
+int FFPacketQueue::count() const {
+    QMutexLocker locker(&_mutex);
+    return _packets.count();
+}
+
+int FFPacketQueue::bytes() const {
+    QMutexLocker locker(&_mutex);
+    return _bytes;
+}
+
+int FFPacketQueue::serial() const {
+    QMutexLocker locker(&_mutex);
+    return _serial;
+}
+
+bool FFPacketQueue::isAborted() const {
+    QMutexLocker locker(&_mutex);
+    return _isAborted;
+}
+
+bool FFPacketQueue::isDrained() const {
+    QMutexLocker locker(&_mutex);
+    return _isAborted || (_isFinished && _packets.isEmpty());
+}
+
+int FFPacketQueue::maxPackets() const {
+    QMutexLocker locker(&_mutex);
+    return _maxPackets;
+}
+
+int FFPacketQueue::maxBytes() const {
+    QMutexLocker locker(&_mutex);
+    return _maxBytes;
+}
+
+void FFPacketQueue::setLimits(int maxPackets, int maxBytes) {
+    QMutexLocker locker(&_mutex);
+    _maxPackets = qMax(1, maxPackets);
+    _maxBytes = qMax(1, maxBytes);
+    _notFull.wakeAll();
+}
@@ -0,0 +1,106 @@
+//
+//  ffpacketqueue.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFPACKETQUEUE_H
+#define FFPACKETQUEUE_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+#include "ffheaders.h"
+
+/**
+ * Bounded blocking queue of demuxed packets.
+ *
+ * put() blocks while the queue holds maxPackets packets or maxBytes bytes,
+ * get() blocks while it is empty. finish() marks the end of stream and
+ * abort() wakes up all waiting threads. Every flush() starts a new serial,
+ * packets carry the serial they were queued with.
+ */
+class FFPacketQueue {
+public:
+    explicit FFPacketQueue(int maxPackets = 256, int maxBytes = 16 * 1024 * 1024);
+    ~FFPacketQueue();
+
+    // Takes over the packet reference, false if the queue was aborted.
+    // Also false if the queue was full while put() is interrupted, the
+    // packet is then left with the caller. The receive time, in msecs of
+    // the caller's clock, is passed through.
+    bool put(AVPacket *packet, qint64 received = 0);
+    // False if the queue was aborted or finished and empty.
+    bool get(AVPacket *packet, int *serial = 0, qint64 *received = 0);
+    // Does not block, false if the queue is empty or aborted.
+    bool tryGet(AVPacket *packet, int *serial = 0, qint64 *received = 0);
+
+    void flush();
+    void finish();
+    void abort();
+    void reset();
+
+    // A full queue does not block put() while set, e.g. while a seek is
+    // pending that will flush the queue anyway.
+    void setIsPutInterrupted(bool isPutInterrupted);
+
+    int count() const;
+    int bytes() const;
+    int serial() const;
+    bool isAborted() const;
+    // Aborted, or finished and empty: get() would return false.
+    bool isDrained() const;
+
+    int maxPackets() const;
+    int maxBytes() const;
+    void setLimits(int maxPackets, int maxBytes);
+
+private:
+    Q_DISABLE_COPY(FFPacketQueue)
+
+    bool takeLocked(AVPacket *packet, int *serial, qint64 *received);
+    bool isFullLocked() const;
+
+    struct QueuedPacket {
+        AVPacket    packet;
+        int         serial;
+        qint64      received;
+    };
+
+    QQueue<QueuedPacket> _packets;
+    int                  _bytes;
+    int                  _serial;
+    int                  _maxPackets;
+    int                  _maxBytes;
+    bool                 _isFinished;
+    bool                 _isAborted;
+    bool                 _isPutInterrupted;
+
+    mutable QMutex       _mutex;
+    QWaitCondition       _notEmpty;
+    QWaitCondition       _notFull;
+};
+
+#endif // FFPACKETQUEUE_H
@@ -27,27 +27,186 @@
 
 #include "ffplayer.h"
 
+#include <QDir>
+#include <QElapsedTimer>
 #include <QDebug>
+#include <QPointer>
 #include <QtConcurrent>
 #include <QSharedPointer>
 
 #include "ffheaders.h"
 #include "ffdecoder.h"
+#include "ffpacketqueue.h"
+#include "ffframequeue.h"
+#include "ffclock.h"
+#include "ffframering.h"
+#include "ffkeyframeindex.h"
+#include "ffprobecache.h"
+#include "ffplayerpool.h"
+#include "ffsessionregistry.h"
 
 #define DEFAULT_INTERRUPT_TIMEOUT   300000       // 300 sec.
 #define READ_INTERRUPT_TIMEOUT      10000        // 10 sec.
 
-#define THREAD_SLEEP_TIMEOUT        1000         // 1 sec.
+#define RECONNECT_MIN_DELAY         250          // msecs, doubled per attempt
+#define RECONNECT_MAX_DELAY         30000        // msecs
+
+#define MAX_CLOCK_DRIFT             10.0         // sec.
+#define MIN_LATE_FRAME_THRESHOLD    0.04         // sec.
+
+#define BACKPRESSURE_ESCALATE       15           // lagging frames before a cheaper decode mode
+#define BACKPRESSURE_RECOVER        2000         // msecs on time before a more expensive one
+
+#define DEFAULT_CATCH_UP_THRESHOLD  150          // msecs
+#define LATENCY_SMOOTHING           8            // weight of the previous estimate
+
+#define KEYFRAME_INDEX_SUFFIX       ".ffindex"
+
+#define POOLED_SLICE_BUDGET         5            // msecs a pooled player works before it yields its worker
+
+// Decode stage state kept across the packets of a session.
+struct FFDecodeState {
+    FFDecodeState() :
+        serial(0), received(0), isLowLatency(false), isPooled(false),
+        isKeyframePreview(false), isWaitingForKeyframe(false), skipLevel(FFPlayer::SkipNone) {}
+
+    int     serial;             // of the packets the codec holds
+    qint64  received;
+    bool    isLowLatency;
+    bool    isPooled;
+    bool    isKeyframePreview;
+    bool    isWaitingForKeyframe;
+    int     skipLevel;          // of the previous packet
+};
+
+// Convert stage state kept across the frames of a session.
+struct FFConvertState {
+    FFConvertState() : targetSerial(-1), target(0.0), hasTarget(false), isLowLatency(false) {}
+
+    int     targetSerial;
+    double  target;
+    bool    hasTarget;
+    bool    isLowLatency;
+};
+
+class FFPlayerPrivate;
+
+/*
+ * Decode and convert stages of a player attached to an FFPlayerPool, run
+ * as short tasks on the pool's workers instead of on threads of their own.
+ * At most one task of a session runs at a time, it never blocks on the
+ * queues or the clock: due frames are waited for on the scheduler's timer.
+ */
+class FFPooledStages : public QEnableSharedFromThis<FFPooledStages> {
+public:
+    FFPooledStages(FFPlayerPrivate *player, FFDecoder *decoder, int *optionsRevision,
+                   FFScheduler *scheduler, FFScheduler::Priority priority);
+
+    // Queues a run unless one is queued or running, any thread.
+    void wake();
+    void waitForFinished();
+
+    void appendFrames(const QList<FFFramePtr> &decoded, int serial, qint64 received);
+    void removeFrame();
+
+    struct PendingFrame {
+        FFFramePtr  frame;
+        int         serial;
+        qint64      received;
+        bool        isPrepared;
+        bool        isPaced;
+        bool        isPreview;
+    };
+
+public:
+    FFDecoder            *decoder;
+    int                  *optionsRevision;
+    FFDecodeState        decodeState;
+    FFConvertState       convertState;
+    FFDecodeState        audioDecodeState;
+    FFConvertState       audioConvertState;
+
+    // Decoded frames not emitted yet, the convert stage takes the head.
+    QQueue<PendingFrame> frames;
+    QAtomicInt           videoFrames;           // also read by FFPlayer::statistics()
+    bool                 isDecoderDrained;
+
+    QAtomicInt           priority;
+
+private:
+    void run();
+    void finish();
+
+    FFPlayerPrivate      *_player;
+    FFScheduler          *_scheduler;
+
+    QAtomicInt           _isScheduled;
+    QAtomicInt           _isWakePending;
+    QAtomicInt           _isFinished;
+
+    QMutex               _mutex;
+    QWaitCondition       _finished;
+};
 
 class FFPlayerPrivate  : public QObject {
     Q_DECLARE_PUBLIC(FFPlayer)
 public:
     explicit FFPlayerPrivate();
 
-    void open(const QUrl &url);
-    AVFormatContext *openContext(const QUrl &url);
+    void start(const QUrl &url, const FFIOSourcePtr &source);
+    void open(const QUrl &url, const FFIOSourcePtr &source);
+    AVFormatContext *openContext(const QUrl &url, bool isProbeCacheAllowed);
     void closeContext(AVFormatContext *formatContext);
-    void decodeFrames(AVFormatContext *formatContext);
+    // Decodes the context, with a new decoder whenever a reconnect
+    // brings streams the previous one can not take.
+    bool decodeContext(AVFormatContext **formatContext, const QUrl &url);
+    bool decodeFrames(AVFormatContext **formatContext, const QUrl &url);
+    // False if a full queue turned the packet away for a pending seek,
+    // the packet is then left with the caller.
+    bool queuePacket(const FFDecoder &decoder, AVPacket *packet);
+    bool isConnectionLost(int error) const;
+    bool reconnectContext(AVFormatContext **formatContext, const QUrl &url, FFDecoder *decoder);
+    void beginReconnect();
+    void finishReconnect();
+    bool waitBeforeReconnect();
+    void wakeReconnect();
+    void openKeyframeIndex(AVFormatContext *formatContext, const FFDecoder &decoder);
+    void buildKeyframeIndex(const QString &path, const QString &indexPath, int streamId);
+    void appendKeyframe(AVFormatContext *formatContext, const AVPacket &packet);
+    bool findKeyframe(qint64 timestamp, qint64 *position) const;
+    void closeKeyframeIndex();
+    QString keyframeIndexPath() const;
+    bool seekContext(AVFormatContext *formatContext, const FFDecoder &decoder,
+                     double position, FFPlayer::SeekMode mode);
+    bool isLowLatencyLive() const;
+    void updateLatency(qint64 received);
+    void decodePackets(FFDecoder *decoder, int *optionsRevision);
+    void convertFrames(FFDecoder *decoder);
+    void decodeAudioPackets(FFDecoder *decoder);
+    bool runPooledStages(FFPooledStages *stages, int *wakeAfter);
+    QList<FFFramePtr> decodePacket(FFDecoder *decoder, AVPacket *packet, int serial, qint64 received,
+                                   FFDecodeState *state, int *optionsRevision);
+    QList<FFFramePtr> decodeAudioPacket(FFDecoder *decoder, AVPacket *packet, int serial, qint64 received,
+                                        FFDecodeState *state);
+    void presentAudioFrames(FFDecoder *decoder, const QList<FFFramePtr> &frames, int serial,
+                            qint64 received, FFConvertState *state);
+    bool prepareFrame(FFDecoder *decoder, const FFFramePtr &frame, int serial, qint64 received,
+                      int queuedVideoFrames, FFConvertState *state, bool *isPaced, bool *isPreview);
+    void presentFrame(const FFFramePtr &frame, int serial, qint64 received, bool isPreview);
+    bool scheduleFrame(const FFFramePtr &frame);
+    bool isConsumerLagging();
+    void updateSkipLevel(bool isLagging);
+    bool putFrames(const QList<FFFramePtr> &frames, int serial, qint64 received);
+    void emitFrame(const FFFramePtr &frame);
+    void abortQueues();
+    void interrupt();
+
+    // The demux stage sleeps while paused until any of these changes.
+    bool isReading() const;
+    void waitForReading();
+    void wakeReading();
+    // At the end of a seekable source, until seek() or close().
+    void waitForSeek();
 
     bool isUserNeedAutoReconnect() const;
     void setIsUserNeedAutoReconnect(bool isUserNeedAutoReconnect);
@@ -56,6 +215,7 @@ public:
     void setIsReadyToReconnect(bool isReadyToReconnect);
 
     void resetInterruptTimer(int timeoutInMsecs);
+    bool checkInterrupt();
 
     bool isInterruptedByTimeout() const;
     void setIsInterruptedByTimeout(bool isInterruptedByTimeout);
@@ -63,38 +223,337 @@ public:
     bool isInterruptedByUser() const;
     void setIsInterruptedByUser(bool isInterruptedByUser);
 
-    qint64 interruptTimeMsec() const;
-    void setInterruptTimeMsec(qint64 msecs);
-
     FFPlayer::State state() const;
-    void setState(const FFPlayer::State &state);
+    void setState(FFPlayer::State state);
+    bool changeState(FFPlayer::State from, FFPlayer::State to);
+
+    FFDecoderOptions decoderOptions(int *revision = 0) const;
+    void setDecoderOptions(const FFDecoderOptions &options);
+    int decoderOptionsRevision() const;
+
+    bool isFramePacing() const;
+    void setIsFramePacing(bool isFramePacing);
+
+    bool isAdaptiveSkipping() const;
+    void setIsAdaptiveSkipping(bool isAdaptiveSkipping);
+
+    int backpressureThreshold() const;
+    void setBackpressureThreshold(int frames);
+
+    bool isLowLatency() const;
+    void setIsLowLatency(bool isLowLatency);
+
+    int catchUpThreshold() const;
+    void setCatchUpThreshold(int msecs);
+
+    void probeLimits(int *probeSize, int *probeDuration) const;
+    void setProbeLimits(int probeSize, int probeDuration);
+
+    bool isProbeCaching() const;
+    void setIsProbeCaching(bool isProbeCaching);
+
+    FFPlayer::OpenLatency openLatency() const;
+    void setOpenLatency(const FFPlayer::OpenLatency &latency);
+
+    bool isKeyframeIndexing() const;
+    void setIsKeyframeIndexing(bool isKeyframeIndexing);
+
+    QString keyframeIndexDirectory() const;
+    void setKeyframeIndexDirectory(const QString &directory);
+
+    bool isPausingNetwork() const;
+    void setIsPausingNetwork(bool isPausingNetwork);
+
+    bool isSessionSharing() const;
+    void setIsSessionSharing(bool isSessionSharing);
+
+    bool isKeyframePreview() const;
+    void setIsKeyframePreview(bool isKeyframePreview);
+
+    QSize keyframePreviewSize() const;
+    void setKeyframePreviewSize(const QSize &size);
+
+    FFPlayerPool *playerPool() const;
+    void setPlayerPool(FFPlayerPool *pool);
+
+    FFScheduler::Priority poolPriority() const;
+    void setPoolPriority(FFScheduler::Priority priority);
+
+    // Stages of the running session when it is pooled.
+    void setPooledStages(const QSharedPointer<FFPooledStages> &stages);
+    void wakePooledStages();
+
+    void requestSeek(double position, FFPlayer::SeekMode mode);
+    bool hasSeekRequest() const;
+    bool takeSeekRequest(double *position, FFPlayer::SeekMode *mode);
+
+    // Accurate seeks drop the frames of the serial before the position.
+    bool seekTarget(int serial, double *position) const;
+    void setSeekTarget(int serial, double position);
+
+    // Counters of the pipeline together with the queues and drops.
+    FFStatistics::Snapshot statisticsSnapshot() const;
 
 public:
     FFPlayer             *q_ptr;
     QFutureWatcher<void> future_watcher;
+    FFVideoFramePool     framePool;
+
+    // Pipeline: demux -> packetQueue -> decode -> frameQueue -> convert,
+    // audio apart: demux -> audioPacketQueue -> decode and present, never
+    // behind a video frame waiting for the clock. Both queues are flushed
+    // together, so they share a serial. Pooled players decode and convert
+    // on the pool, see FFPooledStages.
+    FFPacketQueue        packetQueue;
+    FFPacketQueue        audioPacketQueue;
+    FFFrameQueue         frameQueue;
+    QThreadPool          stagePool;
+
+    // Presentation clock, frames are emitted when their position is due.
+    FFClock              clock;
+    bool                 isRealtimeSource;
+    QAtomicInt           droppedFrames;
+
+    // Time base of packet stamps and interrupt deadlines.
+    QElapsedTimer        monotonicTimer;
+    QAtomicInt           frameLatency;
+    QAtomicInt           caughtUpFrames;
+
+    // Pull delivery, see FFPlayer::acquireLatestFrame().
+    FFFrameRing          frameRing;
+    QAtomicInt           frameDelivery;
+
+    // Adaptive skipping under consumer backpressure.
+    QAtomicInt           skipLevel;
+    QAtomicInt           skippedFrames[FFPlayer::SkipNonKey + 1];
+    QList<QWeakPointer<FFFrame> > emittedFrames;   // convert stage only
+    int                  laggingFrames;
+    qint64               onTimeSince;           // msecs of monotonicTimer, -1 while lagging
+
+    // Serial of a seek done while paused, until its first frame is emitted.
+    QAtomicInt           previewSerial;
+
+    // Custom input read instead of the URL, session thread only.
+    FFIOSourcePtr        ioSource;
+
+    // Keyframe index sidecar of local sources, demux thread only. The
+    // builder belongs to the background pass until it is built.
+    QString              sourcePath;
+    FFKeyframeIndex      keyframeIndex;         // loaded sidecar
+    FFKeyframeIndex      keyframeIndexBuilder;  // built on a context of its own
+    bool                 isKeyframeIndexUsable;
+    QFuture<void>        keyframeIndexPass;
+    QAtomicInt           isKeyframeIndexBuilt;
+    QAtomicInt           isKeyframeIndexCanceled;
+
+    // Reconnects, session thread only but for the counters.
+    int                  reconnectAttempts;     // of the current outage
+    QElapsedTimer        reconnectTimer;        // valid during an outage
+    bool                 isDecoderStale;        // reconnected to other streams
+    QAtomicInt           reconnectCount;
+    QAtomicInt           reconnectAttemptCount;
+
+    // Open latency, started on every open and reconnect.
+    QElapsedTimer        openTimer;
+    bool                 isFirstFrameEmitted;   // convert stage only
+
+    // Stage timings and counters over the lifetime of the player.
+    FFStatistics         statistics;
 
 private:
-    FFPlayer::State      _state;
-
-    bool                 _isReadyToReconnect;
-    bool                 _isUserNeedAutoReconnect;
-
-    bool                 _isInterruptedByTimeout;
-    bool                 _isInterruptedByUser;
-    qint64               _interruptTimeMsec; // in MSecs
-
+    // Control plane, read from any thread and from the interrupt callback.
+    QAtomicInt           _state;
+
+    QAtomicInt           _isReadyToReconnect;
+    QAtomicInt           _isUserNeedAutoReconnect;
+
+    QAtomicInt           _isInterruptedByTimeout;
+    QAtomicInt           _isInterruptedByUser;
+    QAtomicInteger<qint64> _interruptDeadline;     // msecs of monotonicTimer
+
+    FFDecoderOptions     _decoderOptions;
+    QAtomicInt           _decoderOptionsRevision;
+
+    bool                 _isFramePacing;
+    bool                 _isAdaptiveSkipping;
+    int                  _backpressureThreshold;
+    bool                 _isLowLatency;
+    int                  _catchUpThreshold;
+
+    int                  _probeSize;
+    int                  _probeDuration;
+    bool                 _isProbeCaching;
+    FFPlayer::OpenLatency _openLatency;
+
+    bool                 _isPausingNetwork;
+    bool                 _isSessionSharing;
+    bool                 _isKeyframePreview;
+    QSize                _keyframePreviewSize;
+    bool                 _isKeyframeIndexing;
+    QString              _keyframeIndexDirectory;
+
+    QPointer<FFPlayerPool> _playerPool;
+    FFScheduler::Priority _poolPriority;
+    QSharedPointer<FFPooledStages> _pooledStages;
+
+    bool                 _isSeekPending;
+    double               _seekPosition;
+    FFPlayer::SeekMode   _seekMode;
+    int                  _seekTargetSerial;
+    double               _seekTarget;
+
+    // Only pair with the wait conditions, the values are atomic.
     mutable QMutex       _stateMutex;
-    mutable QMutex       _interruptMutex;
+    QWaitCondition       _stateCondition;
     mutable QMutex       _reconnectMutex;
+    QWaitCondition       _reconnectCondition;
+    mutable QMutex       _optionsMutex;
+    mutable QMutex       _pacingMutex;
+    mutable QMutex       _seekMutex;
+    mutable QMutex       _latencyMutex;
+    mutable QMutex       _poolMutex;
 };
 
+static bool isRealtimeUrl(const QUrl &url) {
+    static const QStringList realtimeSchemes = QStringList()
+            << "rtsp" << "rtsps" << "rtmp" << "rtmps" << "rtp" << "udp" << "srt";
+
+    return realtimeSchemes.contains(url.scheme().toLower());
+}
+
 static int decode_interrupt_cb(void *opaque) {
     FFPlayerPrivate *is = static_cast<FFPlayerPrivate *>(opaque);
-    if (QDateTime::currentDateTime().toMSecsSinceEpoch() >= is->interruptTimeMsec()) {
-        is->setIsInterruptedByTimeout(true);
+    return static_cast<int>(is->checkInterrupt());
+}
+
+static int keyframe_index_interrupt_cb(void *opaque) {
+    FFPlayerPrivate *is = static_cast<FFPlayerPrivate *>(opaque);
+    return static_cast<int>(is->isKeyframeIndexCanceled.loadAcquire() || is->isInterruptedByUser());
+}
+
+static FFDecoderOptions pooledOptions(FFDecoderOptions options) {
+    // The pool's workers are the parallelism, automatic thread counts
+    // would start threads per player.
+    if (options.threadCount == 0) {
+        options.threadCount = 1;
+    }
+    if (options.conversionThreads == 0) {
+        options.conversionThreads = 1;
+    }
+
+    return options;
+}
+
+/*
+ * FFPooledStages
+ */
+FFPooledStages::FFPooledStages(FFPlayerPrivate *player, FFDecoder *decoder, int *optionsRevision,
+                               FFScheduler *scheduler, FFScheduler::Priority priority) :
+    decoder(decoder),
+    optionsRevision(optionsRevision),
+    decodeState(),
+    convertState(),
+    audioDecodeState(),
+    audioConvertState(),
+    frames(),
+    videoFrames(0),
+    isDecoderDrained(false),
+    priority(priority),
+    _player(player),
+    _scheduler(scheduler),
+    _isScheduled(0),
+    _isWakePending(0),
+    _isFinished(0),
+    _mutex(QMutex::NonRecursive) {
+
+}
+
+void FFPooledStages::wake() {
+    _isWakePending.fetchAndStoreOrdered(1);
+    if (!_isScheduled.testAndSetOrdered(0, 1)) {
+        return;
+    }
+
+    QSharedPointer<FFPooledStages> stages = sharedFromThis();
+    _scheduler->schedule([stages]() { stages->run(); },
+                         static_cast<FFScheduler::Priority>(priority.load()));
+}
+
+void FFPooledStages::waitForFinished() {
+    QMutexLocker locker(&_mutex);
+    while (!_isFinished.loadAcquire()) {
+        _finished.wait(&_mutex);
+    }
+}
+
+void FFPooledStages::appendFrames(const QList<FFFramePtr> &decoded, int serial, qint64 received) {
+    for (int i = 0; i < decoded.count(); i++) {
+        PendingFrame pending;
+        pending.frame = decoded[i];
+        pending.serial = serial;
+        pending.received = received;
+        pending.isPrepared = false;
+        pending.isPaced = false;
+        pending.isPreview = false;
+        frames.enqueue(pending);
+
+        if (decoded[i]->getFrameType() == FFFrame::FFFrameTypeVideo) {
+            videoFrames.ref();
+        }
+    }
+}
+
+void FFPooledStages::removeFrame() {
+    if (frames.head().frame->getFrameType() == FFFrame::FFFrameTypeVideo) {
+        videoFrames.deref();
+    }
+
+    frames.dequeue();
+}
+
+void FFPooledStages::run() {
+    // The player may be gone, late wakes end here.
+    if (_isFinished.loadAcquire()) {
+        return;
+    }
+
+    _isWakePending.fetchAndStoreOrdered(0);
+
+    int wakeAfter = -1;
+    if (_player->runPooledStages(this, &wakeAfter)) {
+        finish();
+        return;
+    }
+
+    QSharedPointer<FFPooledStages> stages = sharedFromThis();
+    FFScheduler::Priority runPriority = static_cast<FFScheduler::Priority>(priority.load());
+
+    // Out of budget, runs again behind the other streams of this worker.
+    if (wakeAfter == 0) {
+        _scheduler->schedule([stages]() { stages->run(); }, runPriority);
+        return;
+    }
+
+    // A frame is due later.
+    if (wakeAfter > 0) {
+        _scheduler->scheduleAfter(wakeAfter, [stages]() { stages->wake(); }, runPriority);
+    }
+
+    _isScheduled.fetchAndStoreOrdered(0);
+
+    // Woken while running.
+    if (_isWakePending.loadAcquire()) {
+        wake();
     }
+}
+
+void FFPooledStages::finish() {
+    frames.clear();
+    videoFrames.store(0);
 
-    return static_cast<int>(is->isInterruptedByTimeout() || is->isInterruptedByUser());
+    QMutexLocker locker(&_mutex);
+    _isFinished.storeRelease(1);
+    _finished.wakeAll();
 }
 
 /*
@@ -103,15 +562,77 @@ static int decode_interrupt_cb(void *opaque) {
 FFPlayerPrivate::FFPlayerPrivate() :
     q_ptr(0),
     future_watcher(),
+    framePool(),
+    packetQueue(),
+    audioPacketQueue(),
+    frameQueue(),
+    stagePool(),
+    clock(),
+    isRealtimeSource(false),
+    droppedFrames(0),
+    monotonicTimer(),
+    frameLatency(0),
+    caughtUpFrames(0),
+    frameRing(),
+    frameDelivery(FFPlayer::SignalDelivery),
+    skipLevel(FFPlayer::SkipNone),
+    emittedFrames(),
+    laggingFrames(0),
+    onTimeSince(-1),
+    previewSerial(-1),
+    ioSource(),
+    sourcePath(),
+    keyframeIndex(),
+    keyframeIndexBuilder(),
+    isKeyframeIndexUsable(false),
+    keyframeIndexPass(),
+    isKeyframeIndexBuilt(0),
+    isKeyframeIndexCanceled(0),
+    reconnectAttempts(0),
+    reconnectTimer(),
+    isDecoderStale(false),
+    reconnectCount(0),
+    reconnectAttemptCount(0),
+    openTimer(),
+    isFirstFrameEmitted(false),
     _state(FFPlayer::StoppedState),
     _isReadyToReconnect(false),
     _isUserNeedAutoReconnect(false),
     _isInterruptedByTimeout(false),
     _isInterruptedByUser(false),
-    _interruptTimeMsec(0),
+    _interruptDeadline(0),
+    _decoderOptions(),
+    _decoderOptionsRevision(0),
+    _isFramePacing(true),
+    _isAdaptiveSkipping(false),
+    _backpressureThreshold(3),
+    _isLowLatency(false),
+    _catchUpThreshold(DEFAULT_CATCH_UP_THRESHOLD),
+    _probeSize(0),
+    _probeDuration(0),
+    _isProbeCaching(false),
+    _openLatency(),
+    _isPausingNetwork(false),
+    _isSessionSharing(false),
+    _isKeyframePreview(false),
+    _keyframePreviewSize(),
+    _isKeyframeIndexing(false),
+    _keyframeIndexDirectory(),
+    _playerPool(),
+    _poolPriority(FFScheduler::NormalPriority),
+    _pooledStages(),
+    _isSeekPending(false),
+    _seekPosition(0.0),
+    _seekMode(FFPlayer::SeekAccurate),
+    _seekTargetSerial(-1),
+    _seekTarget(0.0),
     _stateMutex(QMutex::NonRecursive),
-    _interruptMutex(QMutex::NonRecursive),
-    _reconnectMutex(QMutex::NonRecursive) {
+    _reconnectMutex(QMutex::NonRecursive),
+    _optionsMutex(QMutex::NonRecursive),
+    _pacingMutex(QMutex::NonRecursive),
+    _seekMutex(QMutex::NonRecursive),
+    _latencyMutex(QMutex::NonRecursive),
+    _poolMutex(QMutex::NonRecursive) {
 
     class AVInitializer {
     public:
@@ -133,6 +654,12 @@ FFPlayerPrivate::FFPlayerPrivate() :
     static AVInitializer sAVInit;
     Q_UNUSED(sAVInit);
 
+    // Session, decode, convert and audio stages and the keyframe index
+    // pass, never on the global pool.
+    stagePool.setMaxThreadCount(5);
+
+    monotonicTimer.start();
+
 #ifdef QT_DEBUG
     av_log_set_level(AV_LOG_VERBOSE);
 #else
@@ -140,47 +667,127 @@ FFPlayerPrivate::FFPlayerPrivate() :
 #endif
 }
 
-void FFPlayerPrivate::open(const QUrl &url) {
+void FFPlayerPrivate::start(const QUrl &url, const FFIOSourcePtr &source) {
+    reconnectTimer.invalidate();
+    reconnectAttempts = 0;
+    setIsInterruptedByUser(false);
+    setIsReadyToReconnect(false);
+
+    future_watcher.setFuture(QtConcurrent::run(&stagePool, [this, url, source]() {
+        forever {
+            open(url, source);
+
+            if (isInterruptedByUser() || !isReadyToReconnect() || !waitBeforeReconnect()) {
+                break;
+            }
+        }
+
+        ioSource.clear();
+    }));
+}
+
+void FFPlayerPrivate::open(const QUrl &url, const FFIOSourcePtr &source) {
     Q_Q(FFPlayer);
 
-    // Reset interrupt state.
-    setIsInterruptedByUser(false);
+    // Reset interrupt state, a close() is kept until the player is opened again.
     setIsInterruptedByTimeout(false);
 
-    AVFormatContext *formatContext = openContext(url);
+    // Live sources are paced by the sender.
+    ioSource = source;
+    isRealtimeSource = !source && isRealtimeUrl(url);
+    if (source) {
+        sourcePath = source->filePath();
+    }
+    else {
+        sourcePath = url.isLocalFile() ? url.toLocalFile() :
+                     url.scheme().isEmpty() ? url.toString() : QString();
+    }
+
+    openTimer.start();
+
+    AVFormatContext *formatContext = openContext(url, true);
     if (!formatContext) {
         return;
     }
 
+    finishReconnect();
+
     setState(FFPlayer::PausedState);
     emit(q->contentDidOpened());
 
-    // Start decoding frames.
-    decodeFrames(formatContext);
+    // Start decoding frames. Cached parameters the codecs do not open
+    // with are stale, probe the streams again.
+    if (!decodeContext(&formatContext, url)) {
+        closeContext(formatContext);
+        FFProbeCache::instance()->remove(url.toString());
+
+        formatContext = openContext(url, false);
+        if (formatContext) {
+            decodeContext(&formatContext, url);
+        }
+    }
 
     // Close and free context.
-    closeContext(formatContext);
+    if (formatContext) {
+        closeContext(formatContext);
+    }
 
     setState(FFPlayer::StoppedState);
     emit(q->contentDidClosed());
 }
 
-AVFormatContext *FFPlayerPrivate::openContext(const QUrl &url) {
+AVFormatContext *FFPlayerPrivate::openContext(const QUrl &url, bool isProbeCacheAllowed) {
+    FFPlayer::OpenLatency latency;
+    QElapsedTimer timer;
+    timer.start();
+
     // Allocate memory for AVFormatContext.
     AVFormatContext *formatContext = avformat_alloc_context();
     formatContext->interrupt_callback.callback = decode_interrupt_cb;
     formatContext->interrupt_callback.opaque = this;
 
-    QString filePath = url.toString();
+    // Custom input, the demuxer reads through the source.
+    AVIOContext *ioContext = 0;
+    if (ioSource) {
+        ioContext = ioSource->createContext(formatContext->interrupt_callback);
+        if (!ioContext) {
+            avformat_free_context(formatContext);
+            return 0;
+        }
+
+        formatContext->pb = ioContext;
+        formatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+
+    QString filePath = ioSource ? QString() : url.toString();
 
     // Set the options if its streaming video
     AVDictionary *rtmp_options = 0;
 
     QString urlScheme = url.scheme().toLower();
-    if (urlScheme.compare("rtsp") || urlScheme.compare("rtmp")) {
+    bool isRtsp = urlScheme == "rtsp" || urlScheme == "rtsps";
+    if (isRtsp) {
         av_dict_set(&rtmp_options, "rtsp_transport", "tcp", 0);
     }
 
+    // Low-latency profile, packets are handed out as soon as they arrive.
+    if (isLowLatencyLive()) {
+        formatContext->flags |= AVFMT_FLAG_NOBUFFER;
+        if (isRtsp) {
+            av_dict_set(&rtmp_options, "reorder_queue_size", "0", 0);
+        }
+    }
+
+    int probeSize = 0;
+    int probeDuration = 0;
+    probeLimits(&probeSize, &probeDuration);
+    if (probeSize > 0) {
+        av_dict_set_int(&rtmp_options, "probesize", probeSize, 0);
+    }
+    if (probeDuration > 0) {
+        av_dict_set_int(&rtmp_options, "analyzeduration", probeDuration * 1000LL, 0);
+    }
+
     // Open an input stream.
     // Set interrupt timeout.
     resetInterruptTimer(DEFAULT_INTERRUPT_TIMEOUT);
@@ -188,39 +795,184 @@ AVFormatContext *FFPlayerPrivate::openContext(const QUrl &url) {
                             0, &rtmp_options) < 0) {
         avformat_free_context(formatContext);
         av_dict_free(&rtmp_options);
+        FFIOSource::freeContext(ioContext);
         return 0;
     }
 
-    // Retrieve stream information
-    // Set interrupt timeout.
-    resetInterruptTimer(DEFAULT_INTERRUPT_TIMEOUT);
-    if (avformat_find_stream_info(formatContext, NULL) < 0) {
-        avformat_close_input(&formatContext);
-        avformat_free_context(formatContext);
-        av_dict_free(&rtmp_options);
-        return 0;
+    latency.openInput = timer.restart();
+
+    // Parameters probed on an earlier open skip the probe. Custom inputs
+    // have no URL to key them by.
+    bool isCaching = isProbeCaching() && !ioSource;
+    latency.isProbeCached = isCaching && isProbeCacheAllowed &&
+            FFProbeCache::instance()->apply(filePath, formatContext);
+
+    if (!latency.isProbeCached) {
+        // Retrieve stream information
+        // Set interrupt timeout.
+        resetInterruptTimer(DEFAULT_INTERRUPT_TIMEOUT);
+        if (avformat_find_stream_info(formatContext, NULL) < 0) {
+            avformat_close_input(&formatContext);
+            avformat_free_context(formatContext);
+            av_dict_free(&rtmp_options);
+            FFIOSource::freeContext(ioContext);
+            return 0;
+        }
+
+        if (isCaching) {
+            FFProbeCache::instance()->insert(filePath, formatContext);
+        }
     }
 
+    latency.streamInfo = timer.elapsed();
+    setOpenLatency(latency);
+
     av_dict_free(&rtmp_options);
 
     return formatContext;
 }
 
+bool FFPlayerPrivate::decodeContext(AVFormatContext **formatContext, const QUrl &url) {
+    isDecoderStale = false;
+    bool isDecoded = decodeFrames(formatContext, url);
+
+    // Reconnected to streams the decoder can not take, a new decoder
+    // takes them on the context that is already open.
+    while (isDecoded && isDecoderStale && *formatContext) {
+        isDecoderStale = false;
+        finishReconnect();
+        isDecoded = decodeFrames(formatContext, url);
+    }
+
+    return isDecoded;
+}
+
 void FFPlayerPrivate::closeContext(AVFormatContext *formatContext) {
+    // Custom inputs are not closed along with the context.
+    AVIOContext *ioContext = formatContext->flags & AVFMT_FLAG_CUSTOM_IO ? formatContext->pb : 0;
+
     // Set interrupt timeout.
     resetInterruptTimer(DEFAULT_INTERRUPT_TIMEOUT);
     avformat_close_input(&formatContext);
 
     avformat_free_context(formatContext);
+    FFIOSource::freeContext(ioContext);
 }
 
-void FFPlayerPrivate::decodeFrames(AVFormatContext *formatContext) {
+bool FFPlayerPrivate::decodeFrames(AVFormatContext **formatContext, const QUrl &url) {
     Q_Q(FFPlayer);
 
-    FFDecoder decoder(formatContext);
+    QElapsedTimer timer;
+    timer.start();
+
+    FFPlayerPool *pool = playerPool();
+
+    int optionsRevision = 0;
+    FFDecoderOptions options = decoderOptions(&optionsRevision);
+    options.lowDelay = options.lowDelay || isLowLatencyLive();
+    if (pool) {
+        options = pooledOptions(options);
+    }
+
+    FFDecoder decoder(*formatContext, options);
+    decoder.setFramePool(framePool);
+    decoder.setStatistics(&statistics);
+
+    FFPlayer::OpenLatency latency = openLatency();
+    latency.decoderOpen = timer.elapsed();
+    setOpenLatency(latency);
+
+    if (!decoder.isOpen() && latency.isProbeCached) {
+        return false;
+    }
+
+    openKeyframeIndex(*formatContext, decoder);
+
+    packetQueue.reset();
+    audioPacketQueue.reset();
+    frameQueue.reset();
+    clock.reset();
+
+    skipLevel.store(FFPlayer::SkipNone);
+    emittedFrames.clear();
+    laggingFrames = 0;
+    onTimeSince = -1;
+    previewSerial.store(-1);
+    isFirstFrameEmitted = false;
+    frameLatency.store(0);
+
+    // Decode and convert on their own threads, so I/O and CPU overlap,
+    // or as tasks on the workers of the player pool.
+    QSharedPointer<FFPooledStages> stages;
+    QFuture<void> decodeStage;
+    QFuture<void> convertStage;
+    QFuture<void> audioStage;
+
+    if (pool) {
+        stages = QSharedPointer<FFPooledStages>(new FFPooledStages(this, &decoder, &optionsRevision,
+                                                                   pool->scheduler(), poolPriority()));
+        stages->decodeState.serial = packetQueue.serial();
+        stages->decodeState.isLowLatency = isLowLatencyLive();
+        stages->audioDecodeState.serial = audioPacketQueue.serial();
+        stages->decodeState.isPooled = true;
+        stages->convertState.isLowLatency = stages->decodeState.isLowLatency;
+        setPooledStages(stages);
+    }
+    else {
+        decodeStage = QtConcurrent::run(&stagePool, [this, &decoder, &optionsRevision]() {
+            decodePackets(&decoder, &optionsRevision);
+        });
+        convertStage = QtConcurrent::run(&stagePool, [this, &decoder]() {
+            convertFrames(&decoder);
+        });
+        audioStage = QtConcurrent::run(&stagePool, [this, &decoder]() {
+            decodeAudioPackets(&decoder);
+        });
+    }
+
+    bool isEndOfStream = false;
+    bool isReadPaused = false;
+
+    // Turned away by a full queue while a seek is pending. Stale once the
+    // seek succeeds, queued after all if it fails.
+    AVPacket heldPacket;
+    av_init_packet(&heldPacket);
+    heldPacket.data = NULL;
+    heldPacket.size = 0;
+
+    // Demux stage.
+    while (!isEndOfStream && !isInterruptedByTimeout() && !isInterruptedByUser()) {
+        double seekPosition = 0.0;
+        FFPlayer::SeekMode seekMode = FFPlayer::SeekAccurate;
+        if (takeSeekRequest(&seekPosition, &seekMode)) {
+            if (seekContext(*formatContext, decoder, seekPosition, seekMode)) {
+                av_packet_unref(&heldPacket);
+            }
+            if (stages) {
+                stages->wake();
+            }
+        }
+
+        if (heldPacket.buf) {
+            AVPacket packet;
+            av_init_packet(&packet);
+            av_packet_move_ref(&packet, &heldPacket);
+            if (!queuePacket(decoder, &packet)) {
+                av_packet_move_ref(&heldPacket, &packet);
+            }
+            if (stages) {
+                stages->wake();
+            }
+            continue;
+        }
+
+        if (isReading()) {
+            if (isReadPaused) {
+                resetInterruptTimer(READ_INTERRUPT_TIMEOUT);
+                av_read_play(*formatContext);
+                isReadPaused = false;
+            }
 
-    while (!isInterruptedByTimeout() && !isInterruptedByUser()) {
-        if (state() == FFPlayer::PlayingState) {
             // initialize packet, set data to NULL, let the demuxer fill it
             AVPacket packet;
             av_init_packet(&packet);
@@ -230,169 +982,1624 @@ void FFPlayerPrivate::decodeFrames(AVFormatContext *formatContext) {
             // read frames from the file
             // Set interrupt timeout.
             resetInterruptTimer(READ_INTERRUPT_TIMEOUT);
-            int ret = av_read_frame(formatContext, &packet);
+            qint64 readStarted = FFStatistics::timestamp();
+            int ret = av_read_frame(*formatContext, &packet);
+            if (ret >= 0) {
+                statistics.recordRead(readStarted, packet.size);
+            }
+
+            // Connection lost.
+            if (ret < 0 && isConnectionLost(ret)) {
+                av_packet_unref(&packet);
+
+                // Custom sources are not reconnected, a sequential one
+                // would be probed again from the middle of the stream.
+                if (isUserNeedAutoReconnect() && !ioSource) {
+                    beginReconnect();
+                    if (reconnectContext(formatContext, url, &decoder)) {
+                        continue;
+                    }
+
+                    // Stream parameters changed, a new decoder takes the
+                    // reopened context without connecting again.
+                    if (*formatContext) {
+                        isDecoderStale = true;
+                    }
+                    else {
+                        setIsReadyToReconnect(!isInterruptedByUser());
+                    }
+                }
+
+                break;
+            }
 
             // End of stream.
             if (ret < 0) {
                 setIsReadyToReconnect(false);
                 av_packet_unref(&packet);
-                return;
-            }
 
-            // Connection lost.
-            if (isInterruptedByTimeout()) {
-                if (isUserNeedAutoReconnect()) {
-                    setIsReadyToReconnect(true);
+                // Seekable sources keep the context and the decoder, the
+                // stages drain the codec on the marker and wait for a seek.
+                AVIOContext *ioContext = (*formatContext)->pb;
+                if (!isRealtimeSource && ioContext && (ioContext->seekable & AVIO_SEEKABLE_NORMAL)) {
+                    packet.stream_index = -1;
+                    packetQueue.put(&packet, monotonicTimer.elapsed());
+                    audioPacketQueue.put(&packet, monotonicTimer.elapsed());
+                    av_packet_unref(&packet);
+                    if (stages) {
+                        stages->wake();
+                    }
+
+                    emit(q->endOfStream());
+                    waitForSeek();
+                    continue;
                 }
 
-                av_packet_unref(&packet);
-                return;
+                isEndOfStream = true;
+                break;
             }
 
-            QList<FFFramePtr> frames = decoder.decodeFrames(&packet);
-            for (int i = 0; i < frames.count(); i++) {
-                if (frames[i]->getFrameType() == FFFrame::FFFrameTypeVideo) {
-                    QSharedPointer<FFVideoFrame> frame = qSharedPointerCast<FFVideoFrame>(frames[i]);
-
-                    emit(q->updateVideoFrame(frame));
+            if (decoder.acceptsPacket(&packet)) {
+                if (!queuePacket(decoder, &packet)) {
+                    av_packet_move_ref(&heldPacket, &packet);
+                }
+                if (stages) {
+                    stages->wake();
                 }
             }
 
             av_packet_unref(&packet);
         }
         else {
-            QThread::msleep(100);
+            // Live sources may stop sending instead of idling until they time out.
+            if (!isReadPaused && isRealtimeSource && isPausingNetwork()) {
+                resetInterruptTimer(READ_INTERRUPT_TIMEOUT);
+                isReadPaused = av_read_pause(*formatContext) >= 0;
+            }
+
+            waitForReading();
         }
     }
-}
 
-void FFPlayerPrivate::resetInterruptTimer(int timeoutInMsecs) {
-    QDateTime endDateTime = QDateTime::currentDateTime().addMSecs(timeoutInMsecs);
-    setInterruptTimeMsec(endDateTime.toMSecsSinceEpoch());
-}
+    av_packet_unref(&heldPacket);
 
-FFPlayer::State FFPlayerPrivate::state() const {
-    QMutexLocker stateLock(&_stateMutex);
-    return _state;
-}
+    if (isEndOfStream && !isInterruptedByTimeout() && !isInterruptedByUser()) {
+        // Let the stages deliver everything that is queued.
+        packetQueue.finish();
+        audioPacketQueue.finish();
+    }
+    else {
+        abortQueues();
+    }
 
-void FFPlayerPrivate::setState(const FFPlayer::State &state) {
-    QMutexLocker stateLock(&_stateMutex);
-    _state = state;
-}
+    if (stages) {
+        stages->wake();
+        stages->waitForFinished();
+        setPooledStages(QSharedPointer<FFPooledStages>());
+    }
+    else {
+        decodeStage.waitForFinished();
+        convertStage.waitForFinished();
+        audioStage.waitForFinished();
+    }
 
-bool FFPlayerPrivate::isUserNeedAutoReconnect() const {
-    QMutexLocker stateLock(&_reconnectMutex);
-    return _isUserNeedAutoReconnect;
-}
+    closeKeyframeIndex();
 
-void FFPlayerPrivate::setIsUserNeedAutoReconnect(bool isUserNeedAutoReconnect) {
-    QMutexLocker stateLock(&_reconnectMutex);
-    _isUserNeedAutoReconnect = isUserNeedAutoReconnect;
+    return true;
 }
 
-bool FFPlayerPrivate::isReadyToReconnect() const {
-    return _isReadyToReconnect;
-}
+bool FFPlayerPrivate::queuePacket(const FFDecoder &decoder, AVPacket *packet) {
+    FFPacketQueue &queue = packet->stream_index == decoder.audioStreamIndex() ?
+                           audioPacketQueue : packetQueue;
 
-void FFPlayerPrivate::setIsReadyToReconnect(bool isReadyToReconnect) {
-    _isReadyToReconnect = isReadyToReconnect;
+    // An aborted queue drops the packet, an interrupted one leaves it.
+    return queue.put(packet, monotonicTimer.elapsed()) || queue.isAborted();
 }
 
-bool FFPlayerPrivate::isInterruptedByUser() const {
-    QMutexLocker abortLock(&_interruptMutex);
-    return _isInterruptedByUser;
+bool FFPlayerPrivate::isConnectionLost(int error) const {
+    // Live sources also fail reads when the peer goes away.
+    return isInterruptedByTimeout() || (isRealtimeSource && error != AVERROR_EOF);
 }
 
-void FFPlayerPrivate::setIsInterruptedByUser(bool isInterruptedByUser) {
-    QMutexLocker abortLock(&_interruptMutex);
-    _isInterruptedByUser = isInterruptedByUser;
-}
+bool FFPlayerPrivate::reconnectContext(AVFormatContext **formatContext, const QUrl &url,
+                                       FFDecoder *decoder) {
+    closeContext(*formatContext);
+    *formatContext = 0;
 
-bool FFPlayerPrivate::isInterruptedByTimeout() const {
-    return _isInterruptedByTimeout;
-}
+    while (waitBeforeReconnect()) {
+        setIsInterruptedByTimeout(false);
 
-void FFPlayerPrivate::setIsInterruptedByTimeout(bool isInterruptedByTimeout) {
-    _isInterruptedByTimeout = isInterruptedByTimeout;
-}
+        // Probed in full, reattach() compares the codecs against what the
+        // source sends now, not against the cache.
+        AVFormatContext *context = openContext(url, false);
+        if (!context) {
+            continue;
+        }
 
-qint64 FFPlayerPrivate::interruptTimeMsec() const {
-    return _interruptTimeMsec;
-}
+        *formatContext = context;
 
-void FFPlayerPrivate::setInterruptTimeMsec(qint64 msecs) {
-    _interruptTimeMsec = msecs;
-}
+        // Queued packets belong to the lost connection, the new serial
+        // has the decode stages flush the codecs and take the new streams.
+        packetQueue.flush();
+        audioPacketQueue.flush();
+        clock.stop();
 
-/*
- * FFPlayer
- */
-FFPlayer::FFPlayer(QObject *parent) :
-    QObject(parent),
-    d_ptr(new FFPlayerPrivate) {
+        // Codecs, scalers and the stages keep running when nothing changed.
+        if (!decoder->reattach(context)) {
+            return false;
+        }
 
-    Q_D(FFPlayer);
-    d->q_ptr = this;
+        finishReconnect();
+        return true;
+    }
 
-    qRegisterMetaType<FFVideoFramePtr>("FFVideoFramePtr");
+    return false;
 }
 
-FFPlayer::~FFPlayer() {
-    close();
+void FFPlayerPrivate::beginReconnect() {
+    if (!reconnectTimer.isValid()) {
+        reconnectTimer.start();
+        reconnectAttempts = 0;
+    }
 }
 
-void FFPlayer::open(const QUrl &url) {
-    Q_D(FFPlayer);
+void FFPlayerPrivate::finishReconnect() {
+    Q_Q(FFPlayer);
 
-    if (d->future_watcher.isRunning()) {
-#ifdef QT_DEBUG
-        qWarning()<<"Is already opened!!!";
-#endif
+    if (!reconnectTimer.isValid()) {
         return;
     }
 
-    d->future_watcher.setFuture(QtConcurrent::run([this,url](){
-        Q_D(FFPlayer);
+    int duration = static_cast<int>(reconnectTimer.elapsed());
+    int attempts = reconnectAttempts;
+    reconnectTimer.invalidate();
+    reconnectAttempts = 0;
 
-        forever {
-            d->open(url);
-
-            if (d->isInterruptedByUser() || !d->isReadyToReconnect()) {
-                break;
-            }
-            else {
-                QThread::msleep(THREAD_SLEEP_TIMEOUT);
-            }
-        }
-    }));
+    reconnectCount.ref();
+    emit(q->reconnected(attempts, duration));
 }
 
-void FFPlayer::play() {
-    Q_D(FFPlayer);
+bool FFPlayerPrivate::waitBeforeReconnect() {
+    if (reconnectAttempts == 0) {
+        qsrand(static_cast<uint>(monotonicTimer.nsecsElapsed()) ^ static_cast<uint>(quintptr(this)));
+    }
 
-    d->setState(FFPlayer::PlayingState);
-}
+    // Exponential backoff with jitter over the upper half of the delay,
+    // players that lost the same link do not come back in lockstep.
+    int delay = qMin(RECONNECT_MAX_DELAY, RECONNECT_MIN_DELAY << qMin(reconnectAttempts, 16));
+    delay = delay / 2 + qrand() % (delay / 2 + 1);
 
-void FFPlayer::pause() {
-    Q_D(FFPlayer);
+    reconnectAttempts++;
+    reconnectAttemptCount.ref();
+
+    QMutexLocker reconnectLock(&_reconnectMutex);
+    if (!isInterruptedByUser()) {
+        _reconnectCondition.wait(&_reconnectMutex, delay);
+    }
 
-    d->setState(FFPlayer::PausedState);
+    return !isInterruptedByUser();
+}
+
+void FFPlayerPrivate::wakeReconnect() {
+    QMutexLocker reconnectLock(&_reconnectMutex);
+    _reconnectCondition.wakeAll();
+}
+
+void FFPlayerPrivate::openKeyframeIndex(AVFormatContext *formatContext, const FFDecoder &decoder) {
+    keyframeIndex.clear();
+    keyframeIndexBuilder.clear();
+    isKeyframeIndexUsable = false;
+    isKeyframeIndexBuilt.storeRelease(0);
+    isKeyframeIndexCanceled.storeRelease(0);
+
+    int streamIndex = decoder.videoStreamIndex();
+    if (sourcePath.isEmpty() || streamIndex < 0 || !isKeyframeIndexing()) {
+        return;
+    }
+
+    // Containers with an index of their own seek fine without a sidecar.
+    if ((formatContext->iformat->flags & AVFMT_NO_BYTE_SEEK) ||
+            formatContext->streams[streamIndex]->nb_index_entries > 0) {
+        return;
+    }
+
+    isKeyframeIndexUsable = true;
+
+    QString indexPath = keyframeIndexPath();
+    if (keyframeIndex.load(indexPath, QFileInfo(sourcePath)) && keyframeIndex.isComplete()) {
+        return;
+    }
+
+    // A missing, stale or partial sidecar is built by a linear pass on a
+    // context of its own, seeks of this player do not disturb it.
+    QString path = sourcePath;
+    int streamId = formatContext->streams[streamIndex]->id;
+    keyframeIndexPass = QtConcurrent::run(&stagePool, [this, path, indexPath, streamId]() {
+        buildKeyframeIndex(path, indexPath, streamId);
+    });
+}
+
+void FFPlayerPrivate::buildKeyframeIndex(const QString &path, const QString &indexPath, int streamId) {
+    // A partial sidecar is resumed after its last keyframe.
+    if (keyframeIndexBuilder.load(indexPath, QFileInfo(path))) {
+        keyframeIndexBuilder.detach();
+    }
+
+    AVFormatContext *formatContext = avformat_alloc_context();
+    if (!formatContext) {
+        return;
+    }
+
+    formatContext->interrupt_callback.callback = keyframe_index_interrupt_cb;
+    formatContext->interrupt_callback.opaque = this;
+
+    // Frees the context on failure.
+    if (avformat_open_input(&formatContext, path.toUtf8().constData(), 0, 0) < 0) {
+        return;
+    }
+
+    if (avformat_find_stream_info(formatContext, 0) < 0) {
+        avformat_close_input(&formatContext);
+        return;
+    }
+
+    // The stream of the player by its id, e.g. the PID. The other streams
+    // are not parsed at all.
+    int streamIndex = -1;
+    for (unsigned int i = 0; i < formatContext->nb_streams; i++) {
+        AVStream *stream = formatContext->streams[i];
+        if (streamIndex < 0 && stream->id == streamId &&
+                stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            streamIndex = static_cast<int>(i);
+        }
+        else {
+            stream->discard = AVDISCARD_ALL;
+        }
+    }
+
+    qint64 position = 0;
+    if (streamIndex < 0 ||
+            (keyframeIndexBuilder.find(keyframeIndexBuilder.lastTimestamp(), &position) &&
+             av_seek_frame(formatContext, -1, position, AVSEEK_FLAG_BYTE) < 0)) {
+        avformat_close_input(&formatContext);
+        return;
+    }
+
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = NULL;
+    packet.size = 0;
+
+    int ret = 0;
+    while ((ret = av_read_frame(formatContext, &packet)) >= 0) {
+        if (packet.stream_index == streamIndex) {
+            appendKeyframe(formatContext, packet);
+        }
+
+        av_packet_unref(&packet);
+    }
+
+    avformat_close_input(&formatContext);
+
+    // Indexed from the first packet to the last one.
+    if (ret == AVERROR_EOF) {
+        keyframeIndexBuilder.setIsComplete(true);
+        isKeyframeIndexBuilt.storeRelease(1);
+    }
+}
+
+void FFPlayerPrivate::appendKeyframe(AVFormatContext *formatContext, const AVPacket &packet) {
+    int64_t timestamp = packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts;
+    if (!(packet.flags & AV_PKT_FLAG_KEY) || timestamp == AV_NOPTS_VALUE || packet.pos < 0) {
+        return;
+    }
+
+    AVStream *stream = formatContext->streams[packet.stream_index];
+    keyframeIndexBuilder.append(av_rescale_q(timestamp, stream->time_base, AV_TIME_BASE_Q),
+                                packet.pos);
+}
+
+bool FFPlayerPrivate::findKeyframe(qint64 timestamp, qint64 *position) const {
+    if (!isKeyframeIndexUsable) {
+        return false;
+    }
+
+    // The pass is done with a built index, seeks switch over to it.
+    if (isKeyframeIndexBuilt.loadAcquire()) {
+        return keyframeIndexBuilder.find(timestamp, position);
+    }
+
+    return keyframeIndex.find(timestamp, position);
+}
+
+void FFPlayerPrivate::closeKeyframeIndex() {
+    isKeyframeIndexCanceled.storeRelease(1);
+    keyframeIndexPass.waitForFinished();
+    keyframeIndexPass = QFuture<void>();
+
+    if (!isKeyframeIndexUsable) {
+        return;
+    }
+
+    // A canceled pass is kept when it got further, the next open resumes it.
+    bool isBetter = keyframeIndexBuilder.isComplete() ||
+            keyframeIndexBuilder.lastTimestamp() > keyframeIndex.lastTimestamp();
+
+    if (isBetter && keyframeIndexBuilder.count() > 0) {
+        // Unmap before the sidecar is replaced.
+        keyframeIndex.clear();
+        keyframeIndexBuilder.save(keyframeIndexPath(), QFileInfo(sourcePath));
+    }
+
+    keyframeIndex.clear();
+    keyframeIndexBuilder.clear();
+}
+
+QString FFPlayerPrivate::keyframeIndexPath() const {
+    QString directory = keyframeIndexDirectory();
+    if (directory.isEmpty()) {
+        return sourcePath + KEYFRAME_INDEX_SUFFIX;
+    }
+
+    return QDir(directory).filePath(QFileInfo(sourcePath).fileName() + KEYFRAME_INDEX_SUFFIX);
+}
+
+bool FFPlayerPrivate::seekContext(AVFormatContext *formatContext, const FFDecoder &decoder,
+                                  double position, FFPlayer::SeekMode mode) {
+    int64_t timestamp = static_cast<int64_t>(position * AV_TIME_BASE);
+
+    // Fast seeks land on the nearest keyframe, accurate seeks on the one
+    // before the position and decode forward from there.
+    int64_t maxTimestamp = mode == FFPlayer::SeekFast ? INT64_MAX : timestamp;
+
+    // Set interrupt timeout.
+    resetInterruptTimer(READ_INTERRUPT_TIMEOUT);
+
+    // Containers without an index would be scanned, the sidecar gives the
+    // byte offset of the preceding keyframe right away.
+    qint64 offset = 0;
+    int ret = -1;
+    if (findKeyframe(timestamp, &offset)) {
+        ret = av_seek_frame(formatContext, -1, offset, AVSEEK_FLAG_BYTE);
+    }
+
+    if (ret < 0 && avformat_seek_file(formatContext, -1, INT64_MIN, timestamp, maxTimestamp, 0) < 0) {
+        return false;
+    }
+
+    // Queued packets and frames are stale now, the decode stage flushes
+    // the codec when the first packet of the new serial arrives.
+    packetQueue.flush();
+    audioPacketQueue.flush();
+    frameQueue.flush();
+
+    int serial = packetQueue.serial();
+    setSeekTarget(serial, mode == FFPlayer::SeekAccurate ? position : -1.0);
+
+    bool isPaused = state() != FFPlayer::PlayingState && decoder.videoStreamIndex() >= 0;
+    previewSerial.store(isPaused ? serial : -1);
+
+    // Restart on the first frame after the seek, wakes a waiting convert stage.
+    clock.stop();
+
+    return true;
+}
+
+void FFPlayerPrivate::decodePackets(FFDecoder *decoder, int *optionsRevision) {
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = NULL;
+    packet.size = 0;
+
+    FFDecodeState state;
+    state.serial = packetQueue.serial();
+    state.isLowLatency = isLowLatencyLive();
+
+    int serial = state.serial;
+    qint64 received = 0;
+
+    while (packetQueue.get(&packet, &serial, &received)) {
+        QList<FFFramePtr> frames = decodePacket(decoder, &packet, serial, received,
+                                                &state, optionsRevision);
+        if (!putFrames(frames, serial, received)) {
+            return;
+        }
+    }
+
+    // End of stream, deliver frames still delayed inside the codec.
+    if (!packetQueue.isAborted()) {
+        putFrames(decoder->drainFrames(FFFrame::FFFrameTypeVideo, false), state.serial, state.received);
+    }
+
+    frameQueue.finish();
+}
+
+void FFPlayerPrivate::decodeAudioPackets(FFDecoder *decoder) {
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = NULL;
+    packet.size = 0;
+
+    FFDecodeState decodeState;
+    decodeState.serial = audioPacketQueue.serial();
+    FFConvertState convertState;
+
+    int serial = decodeState.serial;
+    qint64 received = 0;
+
+    while (audioPacketQueue.get(&packet, &serial, &received)) {
+        presentAudioFrames(decoder, decodeAudioPacket(decoder, &packet, serial, received, &decodeState),
+                           serial, received, &convertState);
+    }
+
+    // End of stream, deliver samples still delayed inside the codec.
+    if (!audioPacketQueue.isAborted()) {
+        presentAudioFrames(decoder, decoder->drainFrames(FFFrame::FFFrameTypeAudio, false),
+                           decodeState.serial, decodeState.received, &convertState);
+    }
+}
+
+void FFPlayerPrivate::convertFrames(FFDecoder *decoder) {
+    FFFramePtr frame;
+    int serial = 0;
+    qint64 received = 0;
+
+    FFConvertState state;
+    state.isLowLatency = isLowLatencyLive();
+
+    while (frameQueue.get(&frame, &serial, &received)) {
+        bool isPaced = false;
+        bool isPreview = false;
+
+        if (prepareFrame(decoder, frame, serial, received, frameQueue.count(FFFrame::FFFrameTypeVideo),
+                         &state, &isPaced, &isPreview)) {
+            // Wait until the frame is due.
+            if (isPaced && !clock.waitFor(frame->position)) {
+                break;
+            }
+
+            presentFrame(frame, serial, received, isPreview);
+        }
+
+        frame.clear();
+    }
+}
+
+bool FFPlayerPrivate::runPooledStages(FFPooledStages *stages, int *wakeAfter) {
+    QElapsedTimer slice;
+    slice.start();
+
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = NULL;
+    packet.size = 0;
+
+    int serial = 0;
+    qint64 received = 0;
+
+    forever {
+        if (packetQueue.isAborted()) {
+            return true;
+        }
+
+        // Audio goes out as soon as it is decoded, also while the video
+        // frames ahead of the session wait for the clock.
+        if (slice.elapsed() < POOLED_SLICE_BUDGET && audioPacketQueue.tryGet(&packet, &serial, &received)) {
+            presentAudioFrames(stages->decoder,
+                               decodeAudioPacket(stages->decoder, &packet, serial, received,
+                                                 &stages->audioDecodeState),
+                               serial, received, &stages->audioConvertState);
+            continue;
+        }
+
+        // Convert stage, frames go out in order once they are due.
+        int delay = 0;
+        while (!stages->frames.isEmpty()) {
+            FFPooledStages::PendingFrame &pending = stages->frames.head();
+
+            if (!pending.isPrepared) {
+                pending.isPrepared = true;
+
+                bool isVideo = pending.frame->getFrameType() == FFFrame::FFFrameTypeVideo;
+                if (!prepareFrame(stages->decoder, pending.frame, pending.serial, pending.received,
+                                  stages->videoFrames.load() - (isVideo ? 1 : 0), &stages->convertState,
+                                  &pending.isPaced, &pending.isPreview)) {
+                    stages->removeFrame();
+                    continue;
+                }
+            }
+
+            // Not due yet, the worker moves on to other streams meanwhile.
+            if (pending.isPaced) {
+                delay = clock.remainingMsecs(pending.frame->position);
+                if (delay != 0) {
+                    break;
+                }
+            }
+
+            presentFrame(pending.frame, pending.serial, pending.received, pending.isPreview);
+            stages->removeFrame();
+        }
+
+        // Decoded ahead as far as the frame queue would, or out of budget.
+        if (stages->frames.count() >= frameQueue.maxFrames() ||
+                slice.elapsed() >= POOLED_SLICE_BUDGET) {
+            *wakeAfter = delay;
+            return false;
+        }
+
+        // Decode stage.
+        if (packetQueue.tryGet(&packet, &serial, &received)) {
+            stages->appendFrames(decodePacket(stages->decoder, &packet, serial, received,
+                                              &stages->decodeState, stages->optionsRevision),
+                                 serial, received);
+            continue;
+        }
+
+        if (packetQueue.isDrained() && audioPacketQueue.isDrained()) {
+            // End of stream, deliver frames still delayed inside the codecs.
+            if (!stages->isDecoderDrained) {
+                stages->isDecoderDrained = true;
+                presentAudioFrames(stages->decoder,
+                                   stages->decoder->drainFrames(FFFrame::FFFrameTypeAudio, false),
+                                   stages->audioDecodeState.serial, stages->audioDecodeState.received,
+                                   &stages->audioConvertState);
+                stages->appendFrames(stages->decoder->drainFrames(FFFrame::FFFrameTypeVideo, false),
+                                     stages->decodeState.serial, stages->decodeState.received);
+                continue;
+            }
+
+            if (stages->frames.isEmpty()) {
+                return true;
+            }
+        }
+
+        // Runs again on the next packet, a state change or a due frame.
+        *wakeAfter = delay != 0 ? delay : -1;
+        return false;
+    }
+}
+
+QList<FFFramePtr> FFPlayerPrivate::decodePacket(FFDecoder *decoder, AVPacket *packet, int serial,
+                                                qint64 received, FFDecodeState *state,
+                                                int *optionsRevision) {
+    // A seek flushed the queue, drop what the codec still holds.
+    if (serial != state->serial) {
+        decoder->flush(FFFrame::FFFrameTypeVideo);
+        // The streams of a reconnect start with a serial of their own.
+        decoder->applyReattach(FFFrame::FFFrameTypeVideo);
+        state->serial = serial;
+    }
+
+    state->received = received;
+
+    // End of a source that stays open, deliver frames still delayed
+    // inside the codec. The next seek flushes it again.
+    if (packet->stream_index < 0) {
+        av_packet_unref(packet);
+        return decoder->drainFrames(FFFrame::FFFrameTypeVideo, false);
+    }
+
+    // Apply options changed while playing, and the preview size when the
+    // keyframe preview is switched.
+    bool isKeyframePreview = this->isKeyframePreview();
+    if (decoderOptionsRevision() != *optionsRevision || isKeyframePreview != state->isKeyframePreview) {
+        FFDecoderOptions options = decoderOptions(optionsRevision);
+        if (state->isPooled) {
+            options = pooledOptions(options);
+        }
+
+        QSize previewSize = keyframePreviewSize();
+        if (isKeyframePreview && !previewSize.isEmpty()) {
+            options.outputSize = previewSize;
+        }
+
+        decoder->setOptions(options);
+
+        // Frames after the preview refer to frames it never decoded.
+        if (state->isKeyframePreview && !isKeyframePreview) {
+            state->isWaitingForKeyframe = true;
+        }
+        state->isKeyframePreview = isKeyframePreview;
+    }
+
+    bool isVideo = decoder->isVideoPacket(packet);
+    bool isKeyframe = packet->flags & AV_PKT_FLAG_KEY;
+
+    // Frames after SkipNonKey refer to frames it never decoded.
+    int level = skipLevel.load();
+    if (state->skipLevel == FFPlayer::SkipNonKey && level != FFPlayer::SkipNonKey) {
+        state->isWaitingForKeyframe = true;
+    }
+    state->skipLevel = level;
+
+    if (isVideo && state->isWaitingForKeyframe) {
+        if (!isKeyframe) {
+            av_packet_unref(packet);
+            return QList<FFFramePtr>();
+        }
+
+        state->isWaitingForKeyframe = false;
+    }
+
+    // Keyframe preview, non-key packets never reach the codec.
+    if (isVideo && isKeyframePreview && !isKeyframe) {
+        av_packet_unref(packet);
+        return QList<FFFramePtr>();
+    }
+
+    // Cheaper decode modes while the consumer lags behind, the preview
+    // is the cheapest one.
+    AVDiscard discard = level == FFPlayer::SkipNonKey || isKeyframePreview ? AVDISCARD_NONKEY :
+                        level == FFPlayer::SkipNonReference ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+
+    // Live backlog, catch up on the frames nothing else refers to.
+    if (state->isLowLatency && discard < AVDISCARD_NONREF &&
+            monotonicTimer.elapsed() - received > catchUpThreshold()) {
+        discard = AVDISCARD_NONREF;
+    }
+
+    if (decoder->skipFrame() != discard) {
+        decoder->setSkipFrame(discard);
+    }
+
+    if (isVideo && level == FFPlayer::SkipNonKey && !isKeyframe) {
+        skippedFrames[FFPlayer::SkipNonKey].ref();
+        av_packet_unref(packet);
+        return QList<FFFramePtr>();
+    }
+
+    QList<FFFramePtr> frames = decoder->decodeFrames(FFFrame::FFFrameTypeVideo, packet, false);
+    av_packet_unref(packet);
+
+    // Approximation, codec delay also yields packets without a frame.
+    if (isVideo && level == FFPlayer::SkipNonReference && frames.isEmpty()) {
+        skippedFrames[FFPlayer::SkipNonReference].ref();
+    }
+
+    return frames;
+}
+
+QList<FFFramePtr> FFPlayerPrivate::decodeAudioPacket(FFDecoder *decoder, AVPacket *packet, int serial,
+                                                     qint64 received, FFDecodeState *state) {
+    // A seek flushed the queue, drop what the codec still holds.
+    if (serial != state->serial) {
+        decoder->flush(FFFrame::FFFrameTypeAudio);
+        decoder->applyReattach(FFFrame::FFFrameTypeAudio);
+        state->serial = serial;
+    }
+
+    state->received = received;
+
+    // End of a source that stays open.
+    if (packet->stream_index < 0) {
+        av_packet_unref(packet);
+        return decoder->drainFrames(FFFrame::FFFrameTypeAudio, false);
+    }
+
+    QList<FFFramePtr> frames = decoder->decodeFrames(FFFrame::FFFrameTypeAudio, packet, false);
+    av_packet_unref(packet);
+
+    return frames;
+}
+
+void FFPlayerPrivate::presentAudioFrames(FFDecoder *decoder, const QList<FFFramePtr> &frames, int serial,
+                                         qint64 received, FFConvertState *state) {
+    for (int i = 0; i < frames.count(); i++) {
+        bool isPaced = false;
+        bool isPreview = false;
+
+        if (prepareFrame(decoder, frames[i], serial, received, 0, state, &isPaced, &isPreview)) {
+            presentFrame(frames[i], serial, received, isPreview);
+        }
+    }
+}
+
+bool FFPlayerPrivate::prepareFrame(FFDecoder *decoder, const FFFramePtr &frame, int serial, qint64 received,
+                                   int queuedVideoFrames, FFConvertState *state,
+                                   bool *isPaced, bool *isPreview) {
+    // Decoded before a seek.
+    if (serial != packetQueue.serial()) {
+        return false;
+    }
+
+    bool isVideo = frame->getFrameType() == FFFrame::FFFrameTypeVideo;
+
+    // Accurate seek, frames ending before the position are not converted.
+    if (serial != state->targetSerial) {
+        state->targetSerial = serial;
+        state->hasTarget = seekTarget(serial, &state->target);
+    }
+
+    if (state->hasTarget) {
+        if (frame->position + frame->frameDelayMsec / 1000.0 <= state->target) {
+            return false;
+        }
+
+        if (isVideo) {
+            state->hasTarget = false;
+        }
+    }
+
+    // The frame at a position sought while paused is shown at once.
+    *isPreview = isVideo && serial == previewSerial.load();
+
+    // Audio is handed to the sink as soon as its stage decodes it, the
+    // sink buffers on its own.
+    *isPaced = isVideo && !*isPreview && isFramePacing() && !isRealtimeSource;
+
+    // Live frames behind a newer one, or behind by more than the
+    // threshold, are dropped so the backlog drains.
+    if (state->isLowLatency && isVideo && !*isPreview &&
+            (queuedVideoFrames > 0 || monotonicTimer.elapsed() - received > catchUpThreshold())) {
+        caughtUpFrames.ref();
+        return false;
+    }
+
+    // Late frames are dropped before they are converted.
+    if (*isPaced && !scheduleFrame(frame)) {
+        droppedFrames.ref();
+        return false;
+    }
+
+    // So are frames the consumer has no room for.
+    if (isVideo && !*isPreview && isAdaptiveSkipping()) {
+        bool isLagging = isConsumerLagging();
+        updateSkipLevel(isLagging);
+
+        if (isLagging) {
+            skippedFrames[FFPlayer::SkipConversion].ref();
+            return false;
+        }
+    }
+    else if (!isAdaptiveSkipping() && skipLevel.load() != FFPlayer::SkipNone) {
+        skipLevel.store(FFPlayer::SkipNone);
+    }
+
+    return decoder->convertFrame(frame);
+}
+
+void FFPlayerPrivate::presentFrame(const FFFramePtr &frame, int serial, qint64 received, bool isPreview) {
+    // A seek while waiting.
+    if (serial != packetQueue.serial()) {
+        return;
+    }
+
+    if (isPreview) {
+        clock.start(frame->position);
+        previewSerial.testAndSetOrdered(serial, -1);
+    }
+
+    if (frame->getFrameType() == FFFrame::FFFrameTypeVideo) {
+        updateLatency(received);
+    }
+
+    emitFrame(frame);
+}
+
+bool FFPlayerPrivate::isLowLatencyLive() const {
+    return isRealtimeSource && isLowLatency();
+}
+
+void FFPlayerPrivate::updateLatency(qint64 received) {
+    int current = static_cast<int>(monotonicTimer.elapsed() - received);
+    int previous = frameLatency.load();
+
+    // Convert stage only, no concurrent writers.
+    frameLatency.store(previous == 0 ? current :
+                       (previous * (LATENCY_SMOOTHING - 1) + current) / LATENCY_SMOOTHING);
+}
+
+bool FFPlayerPrivate::isConsumerLagging() {
+    if (frameDelivery.load() == FFPlayer::LatestFrameDelivery) {
+        return frameRing.hasFrame();
+    }
+
+    // Emitted frames still alive are queued in, or held by, the consumer.
+    for (int i = emittedFrames.count() - 1; i >= 0; i--) {
+        if (emittedFrames[i].isNull()) {
+            emittedFrames.removeAt(i);
+        }
+    }
+
+    return emittedFrames.count() >= backpressureThreshold();
+}
+
+void FFPlayerPrivate::updateSkipLevel(bool isLagging) {
+    int level = skipLevel.load();
+
+    if (isLagging) {
+        onTimeSince = -1;
+        if (level == FFPlayer::SkipNone) {
+            level = FFPlayer::SkipConversion;
+        }
+        else if (++laggingFrames >= BACKPRESSURE_ESCALATE && level < FFPlayer::SkipNonKey) {
+            laggingFrames = 0;
+            level++;
+        }
+    }
+    else {
+        laggingFrames = 0;
+
+        // Wall time, SkipNonKey delivers about one frame per GOP.
+        qint64 now = monotonicTimer.elapsed();
+        if (onTimeSince < 0) {
+            onTimeSince = now;
+        }
+        else if (now - onTimeSince >= BACKPRESSURE_RECOVER && level > FFPlayer::SkipNone) {
+            onTimeSince = now;
+            level--;
+        }
+    }
+
+    skipLevel.store(level);
+}
+
+bool FFPlayerPrivate::scheduleFrame(const FFFramePtr &frame) {
+    // First frame or a timestamp discontinuity, restart the clock.
+    if (!clock.isStarted() || qAbs(frame->position - clock.time()) > MAX_CLOCK_DRIFT) {
+        clock.start(frame->position);
+        return true;
+    }
+
+    double lateThreshold = qMax(MIN_LATE_FRAME_THRESHOLD, frame->frameDelayMsec / 1000.0);
+    return clock.time() - frame->position <= lateThreshold;
+}
+
+bool FFPlayerPrivate::putFrames(const QList<FFFramePtr> &frames, int serial, qint64 received) {
+    for (int i = 0; i < frames.count(); i++) {
+        if (!frameQueue.put(frames[i], serial, received)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FFPlayerPrivate::emitFrame(const FFFramePtr &frame) {
+    Q_Q(FFPlayer);
+
+    if (frame->getFrameType() == FFFrame::FFFrameTypeVideo) {
+        qint64 started = FFStatistics::timestamp();
+
+        if (!isFirstFrameEmitted) {
+            isFirstFrameEmitted = true;
+
+            FFPlayer::OpenLatency latency = openLatency();
+            latency.firstFrame = openTimer.elapsed();
+            setOpenLatency(latency);
+        }
+
+        if (frameDelivery.load() == FFPlayer::LatestFrameDelivery) {
+            // Notify only when the ring was drained, so at most one
+            // notification is pending however slow the consumer is.
+            if (frameRing.push(qSharedPointerCast<FFVideoFrame>(frame))) {
+                emit(q->videoFrameAvailable());
+            }
+        }
+        else {
+            if (isAdaptiveSkipping()) {
+                emittedFrames.append(frame.toWeakRef());
+            }
+            else {
+                emittedFrames.clear();
+            }
+
+            emit(q->updateVideoFrame(qSharedPointerCast<FFVideoFrame>(frame)));
+        }
+
+        statistics.record(FFStatistics::StageEmit, started);
+        statistics.addDeliveredFrames(1);
+    }
+    else if (frame->getFrameType() == FFFrame::FFFrameTypeAudio) {
+        emit(q->updateAudioFrame(qSharedPointerCast<FFAudioFrame>(frame)));
+    }
+}
+
+void FFPlayerPrivate::abortQueues() {
+    packetQueue.abort();
+    audioPacketQueue.abort();
+    frameQueue.abort();
+    clock.abort();
+}
+
+void FFPlayerPrivate::interrupt() {
+    setIsInterruptedByUser(true);
+
+    wakeReading();
+    wakeReconnect();
+    abortQueues();
+    wakePooledStages();
+}
+
+bool FFPlayerPrivate::isReading() const {
+    // While paused, read on until the frame at a new position is out.
+    return state() == FFPlayer::PlayingState || previewSerial.load() == packetQueue.serial();
+}
+
+void FFPlayerPrivate::waitForReading() {
+    QMutexLocker stateLock(&_stateMutex);
+    while (state() != FFPlayer::PlayingState && previewSerial.load() != packetQueue.serial() &&
+           !hasSeekRequest() && !isInterruptedByUser()) {
+        _stateCondition.wait(&_stateMutex);
+    }
+}
+
+void FFPlayerPrivate::waitForSeek() {
+    QMutexLocker stateLock(&_stateMutex);
+    while (!hasSeekRequest() && !isInterruptedByUser()) {
+        _stateCondition.wait(&_stateMutex);
+    }
+}
+
+void FFPlayerPrivate::wakeReading() {
+    QMutexLocker stateLock(&_stateMutex);
+    _stateCondition.wakeAll();
+}
+
+void FFPlayerPrivate::resetInterruptTimer(int timeoutInMsecs) {
+    _interruptDeadline.storeRelease(monotonicTimer.elapsed() + timeoutInMsecs);
+}
+
+bool FFPlayerPrivate::checkInterrupt() {
+    // Runs on every blocking FFmpeg call, no locks and no wall clock.
+    if (_isInterruptedByUser.loadAcquire() || _isInterruptedByTimeout.loadAcquire()) {
+        return true;
+    }
+
+    if (monotonicTimer.elapsed() >= _interruptDeadline.loadAcquire()) {
+        _isInterruptedByTimeout.storeRelease(1);
+        return true;
+    }
+
+    return false;
+}
+
+FFPlayer::State FFPlayerPrivate::state() const {
+    return static_cast<FFPlayer::State>(_state.loadAcquire());
+}
+
+/*
+ * State machine:
+ *   Stopped -> Paused      content opened, session thread
+ *   Paused <-> Playing     play() and pause(), ignored while Stopped
+ *   any     -> Stopped     content closed, session thread
+ */
+void FFPlayerPrivate::setState(FFPlayer::State state) {
+    FFPlayer::State current = this->state();
+    while (current != state && !changeState(current, state)) {
+        current = this->state();
+    }
+}
+
+bool FFPlayerPrivate::changeState(FFPlayer::State from, FFPlayer::State to) {
+    Q_Q(FFPlayer);
+
+    if (from == to || !_state.testAndSetOrdered(from, to)) {
+        return false;
+    }
+
+    // The latest state wins when transitions race each other.
+    clock.setPaused(state() != FFPlayer::PlayingState);
+    wakeReading();
+    wakePooledStages();
+
+    emit(q->stateChanged(to));
+    return true;
+}
+
+bool FFPlayerPrivate::isAdaptiveSkipping() const {
+    QMutexLocker pacingLock(&_pacingMutex);
+    return _isAdaptiveSkipping;
+}
+
+void FFPlayerPrivate::setIsAdaptiveSkipping(bool isAdaptiveSkipping) {
+    QMutexLocker pacingLock(&_pacingMutex);
+    _isAdaptiveSkipping = isAdaptiveSkipping;
+}
+
+int FFPlayerPrivate::backpressureThreshold() const {
+    QMutexLocker pacingLock(&_pacingMutex);
+    return _backpressureThreshold;
+}
+
+void FFPlayerPrivate::setBackpressureThreshold(int frames) {
+    QMutexLocker pacingLock(&_pacingMutex);
+    _backpressureThreshold = qMax(1, frames);
+}
+
+bool FFPlayerPrivate::isLowLatency() const {
+    QMutexLocker pacingLock(&_pacingMutex);
+    return _isLowLatency;
+}
+
+void FFPlayerPrivate::setIsLowLatency(bool isLowLatency) {
+    QMutexLocker pacingLock(&_pacingMutex);
+    _isLowLatency = isLowLatency;
+}
+
+int FFPlayerPrivate::catchUpThreshold() const {
+    QMutexLocker pacingLock(&_pacingMutex);
+    return _catchUpThreshold;
+}
+
+void FFPlayerPrivate::setCatchUpThreshold(int msecs) {
+    QMutexLocker pacingLock(&_pacingMutex);
+    _catchUpThreshold = qMax(1, msecs);
+}
+
+bool FFPlayerPrivate::isFramePacing() const {
+    QMutexLocker pacingLock(&_pacingMutex);
+    return _isFramePacing;
+}
+
+void FFPlayerPrivate::setIsFramePacing(bool isFramePacing) {
+    QMutexLocker pacingLock(&_pacingMutex);
+    _isFramePacing = isFramePacing;
+}
+
+void FFPlayerPrivate::probeLimits(int *probeSize, int *probeDuration) const {
+    QMutexLocker optionsLock(&_optionsMutex);
+    *probeSize = _probeSize;
+    *probeDuration = _probeDuration;
+}
+
+void FFPlayerPrivate::setProbeLimits(int probeSize, int probeDuration) {
+    QMutexLocker optionsLock(&_optionsMutex);
+    _probeSize = qMax(0, probeSize);
+    _probeDuration = qMax(0, probeDuration);
+}
+
+bool FFPlayerPrivate::isProbeCaching() const {
+    QMutexLocker optionsLock(&_optionsMutex);
+    return _isProbeCaching;
+}
+
+void FFPlayerPrivate::setIsProbeCaching(bool isProbeCaching) {
+    QMutexLocker optionsLock(&_optionsMutex);
+    _isProbeCaching = isProbeCaching;
+}
+
+FFPlayer::OpenLatency FFPlayerPrivate::openLatency() const {
+    QMutexLocker latencyLock(&_latencyMutex);
+    return _openLatency;
+}
+
+void FFPlayerPrivate::setOpenLatency(const FFPlayer::OpenLatency &latency) {
+    QMutexLocker latencyLock(&_latencyMutex);
+    _openLatency = latency;
+}
+
+bool FFPlayerPrivate::isPausingNetwork() const {
+    QMutexLocker optionsLock(&_optionsMutex);
+    return _isPausingNetwork;
+}
+
+void FFPlayerPrivate::setIsPausingNetwork(bool isPausingNetwork) {
+    QMutexLocker optionsLock(&_optionsMutex);
+    _isPausingNetwork = isPausingNetwork;
+}
+
+bool FFPlayerPrivate::isSessionSharing() const {
+    QMutexLocker optionsLock(&_optionsMutex);
+    return _isSessionSharing;
+}
+
+void FFPlayerPrivate::setIsSessionSharing(bool isSessionSharing) {
+    QMutexLocker optionsLock(&_optionsMutex);
+    _isSessionSharing = isSessionSharing;
+}
+
+bool FFPlayerPrivate::isKeyframePreview() const {
+    QMutexLocker optionsLock(&_optionsMutex);
+    return _isKeyframePreview;
+}
+
+void FFPlayerPrivate::setIsKeyframePreview(bool isKeyframePreview) {
+    QMutexLocker optionsLock(&_optionsMutex);
+    _isKeyframePreview = isKeyframePreview;
+}
+
+QSize FFPlayerPrivate::keyframePreviewSize() const {
+    QMutexLocker optionsLock(&_optionsMutex);
+    return _keyframePreviewSize;
+}
+
+void FFPlayerPrivate::setKeyframePreviewSize(const QSize &size) {
+    QMutexLocker optionsLock(&_optionsMutex);
+    _keyframePreviewSize = size;
+
+    // Applied by the decode stage like any other option change.
+    _decoderOptionsRevision.ref();
+}
+
+bool FFPlayerPrivate::isKeyframeIndexing() const {
+    QMutexLocker optionsLock(&_optionsMutex);
+    return _isKeyframeIndexing;
+}
+
+void FFPlayerPrivate::setIsKeyframeIndexing(bool isKeyframeIndexing) {
+    QMutexLocker optionsLock(&_optionsMutex);
+    _isKeyframeIndexing = isKeyframeIndexing;
+}
+
+QString FFPlayerPrivate::keyframeIndexDirectory() const {
+    QMutexLocker optionsLock(&_optionsMutex);
+    return _keyframeIndexDirectory;
+}
+
+void FFPlayerPrivate::setKeyframeIndexDirectory(const QString &directory) {
+    QMutexLocker optionsLock(&_optionsMutex);
+    _keyframeIndexDirectory = directory;
+}
+
+FFPlayerPool *FFPlayerPrivate::playerPool() const {
+    QMutexLocker optionsLock(&_optionsMutex);
+    return _playerPool.data();
+}
+
+void FFPlayerPrivate::setPlayerPool(FFPlayerPool *pool) {
+    QMutexLocker optionsLock(&_optionsMutex);
+    _playerPool = pool;
+}
+
+FFScheduler::Priority FFPlayerPrivate::poolPriority() const {
+    QMutexLocker optionsLock(&_optionsMutex);
+    return _poolPriority;
+}
+
+void FFPlayerPrivate::setPoolPriority(FFScheduler::Priority priority) {
+    {
+        QMutexLocker optionsLock(&_optionsMutex);
+        _poolPriority = priority;
+    }
+
+    // Also the running session, from its next task on.
+    QMutexLocker poolLock(&_poolMutex);
+    if (_pooledStages) {
+        _pooledStages->priority.store(priority);
+    }
+}
+
+void FFPlayerPrivate::setPooledStages(const QSharedPointer<FFPooledStages> &stages) {
+    QMutexLocker poolLock(&_poolMutex);
+    _pooledStages = stages;
+}
+
+void FFPlayerPrivate::wakePooledStages() {
+    QSharedPointer<FFPooledStages> stages;
+    {
+        QMutexLocker poolLock(&_poolMutex);
+        stages = _pooledStages;
+    }
+
+    if (stages) {
+        stages->wake();
+    }
+}
+
+FFStatistics::Snapshot FFPlayerPrivate::statisticsSnapshot() const {
+    FFStatistics::Snapshot snapshot = statistics.snapshot();
+
+    snapshot.droppedFrames = droppedFrames.load() + caughtUpFrames.load();
+    for (int level = FFPlayer::SkipConversion; level <= FFPlayer::SkipNonKey; level++) {
+        snapshot.droppedFrames += skippedFrames[level].load();
+    }
+
+    snapshot.packetQueueDepth = packetQueue.count() + audioPacketQueue.count();
+    snapshot.packetQueueBytes = packetQueue.bytes() + audioPacketQueue.bytes();
+    snapshot.frameQueueDepth = frameQueue.count();
+
+    // Pooled sessions keep decoded frames on the stages instead.
+    {
+        QMutexLocker poolLock(&_poolMutex);
+        if (_pooledStages) {
+            snapshot.frameQueueDepth += _pooledStages->videoFrames.load();
+        }
+    }
+
+    snapshot.reconnectCount = reconnectCount.load();
+    snapshot.reconnectAttemptCount = reconnectAttemptCount.load();
+
+    return snapshot;
+}
+
+void FFPlayerPrivate::requestSeek(double position, FFPlayer::SeekMode mode) {
+    {
+        QMutexLocker seekLock(&_seekMutex);
+        _isSeekPending = true;
+        _seekPosition = position;
+        _seekMode = mode;
+
+        // The demux stage may be blocked on a full queue, e.g. paused
+        // local playback. Set and cleared with the request, under its lock.
+        packetQueue.setIsPutInterrupted(true);
+        audioPacketQueue.setIsPutInterrupted(true);
+    }
+
+    wakeReading();
+}
+
+bool FFPlayerPrivate::hasSeekRequest() const {
+    QMutexLocker seekLock(&_seekMutex);
+    return _isSeekPending;
+}
+
+bool FFPlayerPrivate::takeSeekRequest(double *position, FFPlayer::SeekMode *mode) {
+    QMutexLocker seekLock(&_seekMutex);
+    if (!_isSeekPending) {
+        return false;
+    }
+
+    // Requests made while scrubbing collapse into the latest one.
+    *position = _seekPosition;
+    *mode = _seekMode;
+    _isSeekPending = false;
+    packetQueue.setIsPutInterrupted(false);
+    audioPacketQueue.setIsPutInterrupted(false);
+
+    return true;
+}
+
+bool FFPlayerPrivate::seekTarget(int serial, double *position) const {
+    QMutexLocker seekLock(&_seekMutex);
+    if (serial != _seekTargetSerial || _seekTarget < 0.0) {
+        return false;
+    }
+
+    *position = _seekTarget;
+    return true;
+}
+
+void FFPlayerPrivate::setSeekTarget(int serial, double position) {
+    QMutexLocker seekLock(&_seekMutex);
+    _seekTargetSerial = serial;
+    _seekTarget = position;
+}
+
+FFDecoderOptions FFPlayerPrivate::decoderOptions(int *revision) const {
+    QMutexLocker optionsLock(&_optionsMutex);
+    if (revision) {
+        *revision = _decoderOptionsRevision.load();
+    }
+
+    return _decoderOptions;
+}
+
+void FFPlayerPrivate::setDecoderOptions(const FFDecoderOptions &options) {
+    QMutexLocker optionsLock(&_optionsMutex);
+    _decoderOptions = options;
+    _decoderOptionsRevision.ref();
+}
+
+int FFPlayerPrivate::decoderOptionsRevision() const {
+    return _decoderOptionsRevision.load();
+}
+
+bool FFPlayerPrivate::isUserNeedAutoReconnect() const {
+    return _isUserNeedAutoReconnect.loadAcquire();
+}
+
+void FFPlayerPrivate::setIsUserNeedAutoReconnect(bool isUserNeedAutoReconnect) {
+    _isUserNeedAutoReconnect.storeRelease(isUserNeedAutoReconnect);
+}
+
+bool FFPlayerPrivate::isReadyToReconnect() const {
+    return _isReadyToReconnect.loadAcquire();
+}
+
+void FFPlayerPrivate::setIsReadyToReconnect(bool isReadyToReconnect) {
+    _isReadyToReconnect.storeRelease(isReadyToReconnect);
+}
+
+bool FFPlayerPrivate::isInterruptedByUser() const {
+    return _isInterruptedByUser.loadAcquire();
+}
+
+void FFPlayerPrivate::setIsInterruptedByUser(bool isInterruptedByUser) {
+    _isInterruptedByUser.storeRelease(isInterruptedByUser);
+}
+
+bool FFPlayerPrivate::isInterruptedByTimeout() const {
+    return _isInterruptedByTimeout.loadAcquire();
+}
+
+void FFPlayerPrivate::setIsInterruptedByTimeout(bool isInterruptedByTimeout) {
+    _isInterruptedByTimeout.storeRelease(isInterruptedByTimeout);
+}
+
+/*
+ * FFPlayer
+ */
+FFPlayer::OpenLatency::OpenLatency() :
+    openInput(0),
+    streamInfo(0),
+    decoderOpen(0),
+    firstFrame(-1),
+    isProbeCached(false) {
+
+}
+
+FFPlayer::FFPlayer(QObject *parent) :
+    QObject(parent),
+    d_ptr(new FFPlayerPrivate) {
+
+    Q_D(FFPlayer);
+    d->q_ptr = this;
+
+    qRegisterMetaType<FFVideoFramePtr>("FFVideoFramePtr");
+    qRegisterMetaType<FFAudioFramePtr>("FFAudioFramePtr");
+    qRegisterMetaType<FFPlayer::State>("FFPlayer::State");
+    qRegisterMetaType<FFPlayer::State>("State");
+}
+
+FFPlayer::~FFPlayer() {
+    close();
+    setPlayerPool(0);
+}
+
+void FFPlayer::open(const QUrl &url) {
+    Q_D(FFPlayer);
+
+    if (d->future_watcher.isRunning() || FFSessionRegistry::instance()->subscriberCount(this) > 0) {
+#ifdef QT_DEBUG
+        qWarning()<<"Is already opened!!!";
+#endif
+        return;
+    }
+
+    // Attach to the session of players with the same content.
+    if (d->isSessionSharing()) {
+        d->openTimer.start();
+        d->isFirstFrameEmitted = false;
+
+        FFSessionRegistry::instance()->subscribe(this, url);
+        return;
+    }
+
+    d->start(url, FFIOSourcePtr());
+}
+
+void FFPlayer::open(const FFIOSourcePtr &source) {
+    Q_D(FFPlayer);
+
+    if (d->future_watcher.isRunning() || FFSessionRegistry::instance()->subscriberCount(this) > 0) {
+#ifdef QT_DEBUG
+        qWarning()<<"Is already opened!!!";
+#endif
+        return;
+    }
+
+    if (!source || !source->isValid()) {
+        return;
+    }
+
+    d->start(QUrl(), source);
+}
+
+void FFPlayer::open(const QByteArray &data) {
+    open(FFIOSource::fromData(data));
+}
+
+void FFPlayer::open(QIODevice *device) {
+    open(FFIOSource::fromDevice(device));
+}
+
+void FFPlayer::play() {
+    Q_D(FFPlayer);
+
+    if (d->changeState(FFPlayer::PausedState, FFPlayer::PlayingState)) {
+        FFSessionRegistry::instance()->updateState(this);
+    }
+}
+
+void FFPlayer::pause() {
+    Q_D(FFPlayer);
+
+    if (d->changeState(FFPlayer::PlayingState, FFPlayer::PausedState)) {
+        FFSessionRegistry::instance()->updateState(this);
+    }
 }
 
 void FFPlayer::close() {
     Q_D(FFPlayer);
 
+    if (FFSessionRegistry::instance()->unsubscribe(this)) {
+        return;
+    }
+
+    if (d->future_watcher.isRunning()) {
+        d->interrupt();
+        d->future_watcher.cancel();
+        d->future_watcher.waitForFinished();
+    }
+}
+
+FFPlayer::State FFPlayer::getState() const {
+    Q_D(const FFPlayer);
+    return d->state();
+}
+
+void FFPlayer::seek(double position, FFPlayer::SeekMode mode) {
+    Q_D(FFPlayer);
+
+    if (!FFSessionRegistry::instance()->seek(this, qMax(0.0, position), mode)) {
+        d->requestSeek(qMax(0.0, position), mode);
+    }
+}
+
+void FFPlayer::sharedSessionOpened() {
+    Q_D(FFPlayer);
+
+    // Already open when moved from another session.
+    if (d->state() == FFPlayer::StoppedState) {
+        d->setState(FFPlayer::PausedState);
+        emit(contentDidOpened());
+    }
+}
+
+void FFPlayer::sharedSessionClosed() {
+    Q_D(FFPlayer);
+
+    if (d->state() != FFPlayer::StoppedState) {
+        d->setState(FFPlayer::StoppedState);
+        emit(contentDidClosed());
+    }
+}
+
+void FFPlayer::deliverSharedFrame(const FFFramePtr &frame) {
+    Q_D(FFPlayer);
+
+    // Every player of the session gets the same frame while it plays.
+    if (d->state() == FFPlayer::PlayingState) {
+        d->emitFrame(frame);
+    }
+}
+
+int FFPlayer::probeSize() const {
+    Q_D(const FFPlayer);
+
+    int probeSize = 0;
+    int probeDuration = 0;
+    d->probeLimits(&probeSize, &probeDuration);
+    return probeSize;
+}
+
+int FFPlayer::probeDuration() const {
+    Q_D(const FFPlayer);
+
+    int probeSize = 0;
+    int probeDuration = 0;
+    d->probeLimits(&probeSize, &probeDuration);
+    return probeDuration;
+}
+
+void FFPlayer::setProbeLimits(int probeSize, int probeDuration) {
+    Q_D(FFPlayer);
+    d->setProbeLimits(probeSize, probeDuration);
+}
+
+bool FFPlayer::isProbeCaching() const {
+    Q_D(const FFPlayer);
+    return d->isProbeCaching();
+}
+
+void FFPlayer::setIsProbeCaching(bool isProbeCaching) {
+    Q_D(FFPlayer);
+    d->setIsProbeCaching(isProbeCaching);
+}
+
+FFPlayer::OpenLatency FFPlayer::openLatency() const {
+    Q_D(const FFPlayer);
+    return d->openLatency();
+}
+
+FFPlayerPool *FFPlayer::playerPool() const {
+    Q_D(const FFPlayer);
+    return d->playerPool();
+}
+
+void FFPlayer::setPlayerPool(FFPlayerPool *pool) {
+    Q_D(FFPlayer);
+
+    FFPlayerPool *current = d->playerPool();
+    if (current == pool) {
+        return;
+    }
+
+    // The running session keeps using the scheduler of its pool.
     if (d->future_watcher.isRunning()) {
-        d->setIsInterruptedByUser(true);
-        d->future_watcher.cancel();
-        d->future_watcher.waitForFinished();
+#ifdef QT_DEBUG
+        qWarning()<<"Player pool can not change while opened!!!";
+#endif
+        return;
+    }
+
+    if (current) {
+        current->detach(this);
+    }
+    if (pool) {
+        pool->attach(this);
     }
+
+    d->setPlayerPool(pool);
 }
 
-FFPlayer::State FFPlayer::getState() const {
+FFScheduler::Priority FFPlayer::poolPriority() const {
     Q_D(const FFPlayer);
-    return d->state();
+    return d->poolPriority();
+}
+
+void FFPlayer::setPoolPriority(FFScheduler::Priority priority) {
+    Q_D(FFPlayer);
+    d->setPoolPriority(priority);
+}
+
+bool FFPlayer::isKeyframePreview() const {
+    Q_D(const FFPlayer);
+    return d->isKeyframePreview();
+}
+
+void FFPlayer::setIsKeyframePreview(bool isKeyframePreview) {
+    Q_D(FFPlayer);
+    d->setIsKeyframePreview(isKeyframePreview);
+    FFSessionRegistry::instance()->resubscribe(this);
+}
+
+QSize FFPlayer::keyframePreviewSize() const {
+    Q_D(const FFPlayer);
+    return d->keyframePreviewSize();
+}
+
+void FFPlayer::setKeyframePreviewSize(const QSize &size) {
+    Q_D(FFPlayer);
+    d->setKeyframePreviewSize(size);
+    FFSessionRegistry::instance()->resubscribe(this);
+}
+
+bool FFPlayer::isSessionSharing() const {
+    Q_D(const FFPlayer);
+    return d->isSessionSharing();
+}
+
+void FFPlayer::setIsSessionSharing(bool isSessionSharing) {
+    Q_D(FFPlayer);
+    d->setIsSessionSharing(isSessionSharing);
+}
+
+bool FFPlayer::isPausingNetwork() const {
+    Q_D(const FFPlayer);
+    return d->isPausingNetwork();
+}
+
+void FFPlayer::setIsPausingNetwork(bool isPausingNetwork) {
+    Q_D(FFPlayer);
+    d->setIsPausingNetwork(isPausingNetwork);
+}
+
+bool FFPlayer::isKeyframeIndexing() const {
+    Q_D(const FFPlayer);
+    return d->isKeyframeIndexing();
+}
+
+void FFPlayer::setIsKeyframeIndexing(bool isKeyframeIndexing) {
+    Q_D(FFPlayer);
+    d->setIsKeyframeIndexing(isKeyframeIndexing);
+}
+
+QString FFPlayer::keyframeIndexDirectory() const {
+    Q_D(const FFPlayer);
+    return d->keyframeIndexDirectory();
+}
+
+void FFPlayer::setKeyframeIndexDirectory(const QString &directory) {
+    Q_D(FFPlayer);
+    d->setKeyframeIndexDirectory(directory);
+}
+
+FFVideoFramePool FFPlayer::framePool() const {
+    Q_D(const FFPlayer);
+    return d->framePool;
 }
 
 bool FFPlayer::isNeedAutoReconnect() const {
@@ -404,3 +2611,304 @@ void FFPlayer::setIsNeedAutoReconnect(bool isNeedAutoReconnect) {
     Q_D(FFPlayer);
     d->setIsUserNeedAutoReconnect(isNeedAutoReconnect);
 }
+
+int FFPlayer::reconnectCount() const {
+    Q_D(const FFPlayer);
+    return d->reconnectCount.load();
+}
+
+int FFPlayer::reconnectAttemptCount() const {
+    Q_D(const FFPlayer);
+    return d->reconnectAttemptCount.load();
+}
+
+FFDecoderOptions FFPlayer::decoderOptions() const {
+    Q_D(const FFPlayer);
+    return d->decoderOptions();
+}
+
+void FFPlayer::setDecoderOptions(const FFDecoderOptions &options) {
+    Q_D(FFPlayer);
+    d->setDecoderOptions(options);
+}
+
+FFVideoFrame::PixelFormat FFPlayer::outputFormat() const {
+    Q_D(const FFPlayer);
+    return d->decoderOptions().outputFormat;
+}
+
+void FFPlayer::setOutputFormat(FFVideoFrame::PixelFormat format) {
+    Q_D(FFPlayer);
+
+    FFDecoderOptions options = d->decoderOptions();
+    options.outputFormat = format;
+    d->setDecoderOptions(options);
+}
+
+QSize FFPlayer::outputSize() const {
+    Q_D(const FFPlayer);
+    return d->decoderOptions().outputSize;
+}
+
+void FFPlayer::setOutputSize(const QSize &size, Qt::AspectRatioMode mode) {
+    Q_D(FFPlayer);
+
+    FFDecoderOptions options = d->decoderOptions();
+    options.outputSize = size;
+    options.aspectRatioMode = mode;
+    d->setDecoderOptions(options);
+}
+
+FFVideoFrame::ScaleQuality FFPlayer::scaleQuality() const {
+    Q_D(const FFPlayer);
+    return d->decoderOptions().scaleQuality;
+}
+
+void FFPlayer::setScaleQuality(FFVideoFrame::ScaleQuality quality) {
+    Q_D(FFPlayer);
+
+    FFDecoderOptions options = d->decoderOptions();
+    options.scaleQuality = quality;
+    d->setDecoderOptions(options);
+}
+
+bool FFPlayer::isFastDecode() const {
+    Q_D(const FFPlayer);
+    return d->decoderOptions().fastDecode;
+}
+
+void FFPlayer::setIsFastDecode(bool isFastDecode) {
+    Q_D(FFPlayer);
+
+    FFDecoderOptions options = d->decoderOptions();
+    options.fastDecode = isFastDecode;
+    d->setDecoderOptions(options);
+}
+
+int FFPlayer::decoderThreadCount() const {
+    Q_D(const FFPlayer);
+    return d->decoderOptions().threadCount;
+}
+
+FFDecoderOptions::ThreadType FFPlayer::decoderThreadType() const {
+    Q_D(const FFPlayer);
+    return d->decoderOptions().threadType;
+}
+
+void FFPlayer::setDecoderThreads(int threadCount, FFDecoderOptions::ThreadType threadType) {
+    Q_D(FFPlayer);
+
+    FFDecoderOptions options = d->decoderOptions();
+    options.threadCount = threadCount;
+    options.threadType = threadType;
+    d->setDecoderOptions(options);
+}
+
+int FFPlayer::conversionThreads() const {
+    Q_D(const FFPlayer);
+    return d->decoderOptions().conversionThreads;
+}
+
+void FFPlayer::setConversionThreads(int conversionThreads) {
+    Q_D(FFPlayer);
+
+    FFDecoderOptions options = d->decoderOptions();
+    options.conversionThreads = conversionThreads;
+    d->setDecoderOptions(options);
+}
+
+void FFPlayer::setPacketQueueLimits(int maxPackets, int maxBytes) {
+    Q_D(FFPlayer);
+    d->packetQueue.setLimits(maxPackets, maxBytes);
+    d->audioPacketQueue.setLimits(maxPackets, maxBytes);
+}
+
+int FFPlayer::packetQueueMaxPackets() const {
+    Q_D(const FFPlayer);
+    return d->packetQueue.maxPackets();
+}
+
+int FFPlayer::packetQueueMaxBytes() const {
+    Q_D(const FFPlayer);
+    return d->packetQueue.maxBytes();
+}
+
+int FFPlayer::frameQueueMaxFrames() const {
+    Q_D(const FFPlayer);
+    return d->frameQueue.maxFrames();
+}
+
+void FFPlayer::setFrameQueueMaxFrames(int maxFrames) {
+    Q_D(FFPlayer);
+    d->frameQueue.setMaxFrames(maxFrames);
+}
+
+bool FFPlayer::isFramePacing() const {
+    Q_D(const FFPlayer);
+    return d->isFramePacing();
+}
+
+void FFPlayer::setIsFramePacing(bool isFramePacing) {
+    Q_D(FFPlayer);
+    d->setIsFramePacing(isFramePacing);
+}
+
+double FFPlayer::playbackRate() const {
+    Q_D(const FFPlayer);
+    return d->clock.rate();
+}
+
+void FFPlayer::setPlaybackRate(double rate) {
+    Q_D(FFPlayer);
+    d->clock.setRate(rate);
+    d->wakePooledStages();
+}
+
+void FFPlayer::setClockPosition(double position) {
+    Q_D(FFPlayer);
+    d->clock.start(position);
+    d->wakePooledStages();
+}
+
+int FFPlayer::droppedFrameCount() const {
+    Q_D(const FFPlayer);
+    return d->droppedFrames.load();
+}
+
+FFStatistics::Snapshot FFPlayer::statistics() const {
+    Q_D(const FFPlayer);
+
+    // Subscribers of a shared session report the pipeline of the session,
+    // delivery is their own.
+    FFStatistics::Snapshot snapshot;
+    if (FFSessionRegistry::instance()->sessionStatistics(this, &snapshot)) {
+        FFStatistics::Snapshot own = d->statistics.snapshot();
+        snapshot.stages[FFStatistics::StageEmit] = own.stages[FFStatistics::StageEmit];
+        snapshot.deliveredFrames = own.deliveredFrames;
+        return snapshot;
+    }
+
+    return d->statisticsSnapshot();
+}
+
+bool FFPlayer::isTracing() const {
+    Q_D(const FFPlayer);
+    return d->statistics.isTracing();
+}
+
+void FFPlayer::setIsTracing(bool isTracing) {
+    Q_D(FFPlayer);
+    d->statistics.setIsTracing(isTracing);
+}
+
+QByteArray FFPlayer::traceEvents() const {
+    Q_D(const FFPlayer);
+    return d->statistics.traceEvents();
+}
+
+bool FFPlayer::isLowLatency() const {
+    Q_D(const FFPlayer);
+    return d->isLowLatency();
+}
+
+void FFPlayer::setIsLowLatency(bool isLowLatency) {
+    Q_D(FFPlayer);
+    d->setIsLowLatency(isLowLatency);
+}
+
+int FFPlayer::catchUpThreshold() const {
+    Q_D(const FFPlayer);
+    return d->catchUpThreshold();
+}
+
+void FFPlayer::setCatchUpThreshold(int msecs) {
+    Q_D(FFPlayer);
+    d->setCatchUpThreshold(msecs);
+}
+
+int FFPlayer::caughtUpFrameCount() const {
+    Q_D(const FFPlayer);
+    return d->caughtUpFrames.load();
+}
+
+int FFPlayer::latency() const {
+    Q_D(const FFPlayer);
+    return d->frameLatency.load();
+}
+
+bool FFPlayer::isAudioEnabled() const {
+    Q_D(const FFPlayer);
+    return d->decoderOptions().decodeAudio;
+}
+
+void FFPlayer::setIsAudioEnabled(bool isAudioEnabled) {
+    Q_D(FFPlayer);
+
+    FFDecoderOptions options = d->decoderOptions();
+    options.decodeAudio = isAudioEnabled;
+    d->setDecoderOptions(options);
+}
+
+void FFPlayer::setAudioOutput(int sampleRate, int channels, FFAudioFrame::SampleFormat format) {
+    Q_D(FFPlayer);
+
+    FFDecoderOptions options = d->decoderOptions();
+    options.audioSampleRate = sampleRate;
+    options.audioChannels = channels;
+    options.audioSampleFormat = format;
+    d->setDecoderOptions(options);
+}
+
+FFPlayer::FrameDelivery FFPlayer::frameDelivery() const {
+    Q_D(const FFPlayer);
+    return static_cast<FFPlayer::FrameDelivery>(d->frameDelivery.load());
+}
+
+void FFPlayer::setFrameDelivery(FFPlayer::FrameDelivery delivery) {
+    Q_D(FFPlayer);
+    d->frameDelivery.store(delivery);
+}
+
+FFVideoFramePtr FFPlayer::acquireLatestFrame() {
+    Q_D(FFPlayer);
+    return d->frameRing.acquire();
+}
+
+int FFPlayer::overwrittenFrameCount() const {
+    Q_D(const FFPlayer);
+    return d->frameRing.overwrittenCount();
+}
+
+bool FFPlayer::isAdaptiveSkipping() const {
+    Q_D(const FFPlayer);
+    return d->isAdaptiveSkipping();
+}
+
+void FFPlayer::setIsAdaptiveSkipping(bool isAdaptiveSkipping) {
+    Q_D(FFPlayer);
+    d->setIsAdaptiveSkipping(isAdaptiveSkipping);
+}
+
+int FFPlayer::backpressureThreshold() const {
+    Q_D(const FFPlayer);
+    return d->backpressureThreshold();
+}
+
+void FFPlayer::setBackpressureThreshold(int frames) {
+    Q_D(FFPlayer);
+    d->setBackpressureThreshold(frames);
+}
+
+FFPlayer::SkipLevel FFPlayer::skipLevel() const {
+    Q_D(const FFPlayer);
+    return static_cast<FFPlayer::SkipLevel>(d->skipLevel.load());
+}
+
+int FFPlayer::skippedFrameCount(FFPlayer::SkipLevel level) const {
+    Q_D(const FFPlayer);
+    if (level <= SkipNone || level > SkipNonKey) {
+        return 0;
+    }
+
+    return d->skippedFrames[level].load();
+}
@@ -29,11 +29,18 @@
 #define FFPLAYER_H
 
 #include <QUrl>
+#include <QSize>
 #include <QScopedPointer>
 
 #include "ffvideoframe.h"
 #include "ffaudioframe.h"
+#include "ffvideoframepool.h"
+#include "ffdecoderoptions.h"
+#include "ffscheduler.h"
+#include "ffstatistics.h"
+#include "ffiosource.h"
 
+class FFPlayerPool;
 class FFPlayerPrivate;
 class FFPlayer : public QObject {
     Q_OBJECT
@@ -45,25 +52,236 @@ public:
         PausedState
     };
 
+    /** Video frame delivery */
+    enum FrameDelivery {
+        SignalDelivery,         // every frame through updateVideoFrame()
+        LatestFrameDelivery     // videoFrameAvailable() and acquireLatestFrame()
+    };
+
+    /** Decode shortcuts taken while the consumer lags behind */
+    enum SkipLevel {
+        SkipNone,
+        SkipConversion,         // frames without room are not converted
+        SkipNonReference,       // the codec skips non-reference frames
+        SkipNonKey              // only keyframes are decoded
+    };
+
+    /** Seek precision */
+    enum SeekMode {
+        SeekFast,               // the nearest keyframe
+        SeekAccurate            // the frame at the position, decoded from the preceding keyframe
+    };
+
+    /** Time spent opening the content, in msecs */
+    struct OpenLatency {
+        OpenLatency();
+
+        qint64  openInput;      // connect and read the header
+        qint64  streamInfo;     // probe the streams, next to 0 with cached parameters
+        qint64  decoderOpen;    // open the codecs
+        qint64  firstFrame;     // from the open to the first video frame, -1 until then
+        bool    isProbeCached;
+    };
+
     explicit FFPlayer(QObject *parent = 0);
     virtual ~FFPlayer();
 
     void open(const QUrl &url);
+    // Content read through a custom AVIOContext instead of a URL, e.g.
+    // from memory or FFIOSource::fromMappedFile(). Always opened by this
+    // player alone, session sharing and reconnects do not apply.
+    void open(const FFIOSourcePtr &source);
+    void open(const QByteArray &data);
+    // Not owned, read from the decoding thread. A file or a buffer, see
+    // FFIOSource::fromDevice().
+    void open(QIODevice *device);
     void close();
     void play();
     void pause();
 
+    // Lost connections are reopened with exponential backoff and jitter.
+    // The open codecs and scalers are kept while the stream parameters
+    // do not change.
     bool isNeedAutoReconnect() const;
     void setIsNeedAutoReconnect(bool isNeedAutoReconnect);
+    int reconnectCount() const;
+    int reconnectAttemptCount() const;
 
     State getState() const;
 
+    // Decode and convert on the workers of a shared pool instead of on
+    // threads of this player, from the next open on. Codecs and scalers
+    // with an automatic thread count then use a single thread. 0 detaches
+    // the player. Ignored while the player is open, close() it first.
+    FFPlayerPool *playerPool() const;
+    void setPlayerPool(FFPlayerPool *pool);
+    // Run queue priority on the pool, e.g. higher for the stream shown
+    // in full. Also applies to the running session.
+    FFScheduler::Priority poolPriority() const;
+    void setPoolPriority(FFScheduler::Priority priority);
+
+    // Players opening the same URL with the same output options share one
+    // connection and decode, from the next open on. The settings of the
+    // first one open the session, seeks apply to all of them. Play and
+    // pause stay per player, the session plays while any of them does.
+    bool isSessionSharing() const;
+    void setIsSessionSharing(bool isSessionSharing);
+
+    // Pausing a live source also pauses the transfer, e.g. RTSP PAUSE,
+    // instead of leaving the connection idle.
+    bool isPausingNetwork() const;
+    void setIsPausingNetwork(bool isPausingNetwork);
+
+    // Probe limits of the next open, 0 keeps the FFmpeg defaults. Small
+    // limits open live streams faster but may miss stream parameters.
+    int probeSize() const;
+    int probeDuration() const;      // msecs
+    void setProbeLimits(int probeSize, int probeDuration);
+
+    // Codec parameters probed once are reused by later opens of the same
+    // URL. Stale parameters fall back to a full probe, reconnects always
+    // probe in full and refresh the cache.
+    bool isProbeCaching() const;
+    void setIsProbeCaching(bool isProbeCaching);
+
+    OpenLatency openLatency() const;
+
+    // Position in seconds, on the timeline of the frame positions. While
+    // paused the frame at the new position is still delivered. Seekable
+    // sources stay open at their end, see endOfStream().
+    void seek(double position, SeekMode mode = SeekAccurate);
+
+    // Local files in containers without an index of their own, e.g.
+    // MPEG-TS, get a keyframe index sidecar "<file>.ffindex" next to them
+    // or in keyframeIndexDirectory(). A missing one is built by a
+    // background pass over the file, seeks use it once the pass is done
+    // and later opens right away.
+    bool isKeyframeIndexing() const;
+    void setIsKeyframeIndexing(bool isKeyframeIndexing);
+    QString keyframeIndexDirectory() const;
+    void setKeyframeIndexDirectory(const QString &directory);
+
+    FFVideoFramePool framePool() const;
+
+    FFDecoderOptions decoderOptions() const;
+    void setDecoderOptions(const FFDecoderOptions &options);
+
+    FFVideoFrame::PixelFormat outputFormat() const;
+    void setOutputFormat(FFVideoFrame::PixelFormat format);
+
+    QSize outputSize() const;
+    void setOutputSize(const QSize &size, Qt::AspectRatioMode mode = Qt::KeepAspectRatio);
+
+    FFVideoFrame::ScaleQuality scaleQuality() const;
+    void setScaleQuality(FFVideoFrame::ScaleQuality quality);
+
+    bool isFastDecode() const;
+    void setIsFastDecode(bool isFastDecode);
+
+    int decoderThreadCount() const;
+    FFDecoderOptions::ThreadType decoderThreadType() const;
+    void setDecoderThreads(int threadCount,
+                           FFDecoderOptions::ThreadType threadType = FFDecoderOptions::ThreadTypeAuto);
+
+    int conversionThreads() const;
+    void setConversionThreads(int conversionThreads);
+
+    // Frames of local content are emitted on their position against a
+    // monotonic clock, late frames are dropped. Live streams are not paced.
+    bool isFramePacing() const;
+    void setIsFramePacing(bool isFramePacing);
+
+    double playbackRate() const;
+    void setPlaybackRate(double rate);
+
+    // Slaves the presentation clock to an external master, e.g. the
+    // position reported by an audio sink, in seconds.
+    void setClockPosition(double position);
+
+    int droppedFrameCount() const;
+
+    // Per-stage timing histograms and counters since the player was
+    // created, always collected. Stage trace events are kept while tracing
+    // is enabled, traceEvents() exports them as Chrome trace JSON.
+    FFStatistics::Snapshot statistics() const;
+    bool isTracing() const;
+    void setIsTracing(bool isTracing);
+    QByteArray traceEvents() const;
+
+    // Low-latency profile for live sources, applied on the next open:
+    // no demuxer buffering or RTP reordering, low delay decoding, and
+    // video frames behind a newer one or older than catchUpThreshold()
+    // msecs are dropped before conversion.
+    bool isLowLatency() const;
+    void setIsLowLatency(bool isLowLatency);
+    int catchUpThreshold() const;
+    void setCatchUpThreshold(int msecs);
+    int caughtUpFrameCount() const;
+
+    // Smoothed time from reading a packet to delivering its video frame,
+    // in msecs.
+    int latency() const;
+
+    FrameDelivery frameDelivery() const;
+    void setFrameDelivery(FrameDelivery delivery);
+
+    // Single consumer only. Returns the newest frame published since the
+    // last call or null, older unread frames are overwritten.
+    FFVideoFramePtr acquireLatestFrame();
+    int overwrittenFrameCount() const;
+
+    // The consumer lags when backpressureThreshold() emitted frames are
+    // still alive (or an unread frame sits in the ring). The player then
+    // steps through cheaper SkipLevels and recovers once it catches up.
+    bool isAdaptiveSkipping() const;
+    void setIsAdaptiveSkipping(bool isAdaptiveSkipping);
+    int backpressureThreshold() const;
+    void setBackpressureThreshold(int frames);
+
+    // Keyframe preview for overview tiles: non-key packets are dropped
+    // before decoding, about one frame per GOP is converted, at
+    // keyframePreviewSize() when set. Switches while playing, full
+    // decoding resumes at the next keyframe. A shared player moves to the
+    // session of the players with the same preview settings instead.
+    bool isKeyframePreview() const;
+    void setIsKeyframePreview(bool isKeyframePreview);
+    QSize keyframePreviewSize() const;
+    void setKeyframePreviewSize(const QSize &size);
+
+    SkipLevel skipLevel() const;
+    int skippedFrameCount(SkipLevel level) const;
+
+    // Audio frames are emitted through updateAudioFrame() when enabled.
+    bool isAudioEnabled() const;
+    void setIsAudioEnabled(bool isAudioEnabled);
+    // 0 keeps the source sample rate or channel count.
+    void setAudioOutput(int sampleRate, int channels,
+                        FFAudioFrame::SampleFormat format = FFAudioFrame::SampleFormatS16);
+
+    // Depth of each of the video and the audio queue between the demux
+    // and the decode stages.
+    int packetQueueMaxPackets() const;
+    int packetQueueMaxBytes() const;
+    void setPacketQueueLimits(int maxPackets, int maxBytes);
+
+    // Depth of the queue between the decode and convert stages.
+    int frameQueueMaxFrames() const;
+    void setFrameQueueMaxFrames(int maxFrames);
+
 signals:
     void updateVideoFrame(FFVideoFramePtr frame);
+    void updateAudioFrame(FFAudioFramePtr frame);
+    void videoFrameAvailable();
     void stateChanged(State status);
 
     void contentDidOpened();
     void contentDidClosed();
+    // The last packet of a seekable source was read. The player stays
+    // open with its decoder for seek() until close().
+    void endOfStream();
+
+    // Outage duration in msecs, from the lost connection to the reopen.
+    void reconnected(int attempts, int duration);
 
 public slots:
 
@@ -71,11 +289,20 @@ protected:
     QScopedPointer<FFPlayerPrivate> d_ptr;
 
 private:
+    friend class FFSessionRegistry;
+
+    // Front-end of a shared session, called by FFSessionRegistry.
+    void sharedSessionOpened();
+    void sharedSessionClosed();
+    void deliverSharedFrame(const FFFramePtr &frame);
+
     Q_DECLARE_PRIVATE(FFPlayer)
     Q_DISABLE_COPY(FFPlayer)
 };
 
 Q_DECLARE_METATYPE(FFVideoFramePtr)
+Q_DECLARE_METATYPE(FFAudioFramePtr)
+Q_DECLARE_METATYPE(FFPlayer::State)
 typedef QSharedPointer<FFPlayer> FFPlayerPtr;
 
 #endif // FFPLAYER_H
@@ -0,0 +1,116 @@
+//
+//  ffplayerpool.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffplayerpool.h"
+
+#include <QMutex>
+
+#include "ffplayer.h"
+
+class FFPlayerPoolPrivate {
+public:
+    FFPlayerPoolPrivate(int threadCount, QThread::Priority threadPriority);
+
+public:
+    FFScheduler          scheduler;
+
+    QList<FFPlayer *>    players;
+    mutable QMutex       mutex;
+};
+
+/*
+ * FFPlayerPoolPrivate
+ */
+FFPlayerPoolPrivate::FFPlayerPoolPrivate(int threadCount, QThread::Priority threadPriority) :
+    scheduler(threadCount, threadPriority),
+    players(),
+    mutex(QMutex::NonRecursive) {
+
+}
+
+/*
+ * FFPlayerPool
+ */
+FFPlayerPool::FFPlayerPool(int threadCount, QThread::Priority threadPriority, QObject *parent) :
+    QObject(parent),
+    d_ptr(new FFPlayerPoolPrivate(threadCount, threadPriority)) {
+
+}
+
+FFPlayerPool::~FFPlayerPool() {
+    Q_D(FFPlayerPool);
+
+    QList<FFPlayer *> players;
+    {
+        QMutexLocker locker(&d->mutex);
+        players = d->players;
+    }
+
+    // Their stages run on the workers about to be stopped.
+    for (int i = 0; i < players.count(); i++) {
+        players[i]->close();
+        players[i]->setPlayerPool(0);
+    }
+}
+
+int FFPlayerPool::threadCount() const {
+    Q_D(const FFPlayerPool);
+    return d->scheduler.threadCount();
+}
+
+int FFPlayerPool::playerCount() const {
+    Q_D(const FFPlayerPool);
+
+    QMutexLocker locker(&d->mutex);
+    return d->players.count();
+}
+
+int FFPlayerPool::stolenTaskCount() const {
+    Q_D(const FFPlayerPool);
+    return d->scheduler.stolenCount();
+}
+
+FFScheduler *FFPlayerPool::scheduler() const {
+    Q_D(const FFPlayerPool);
+    return const_cast<FFScheduler *>(&d->scheduler);
+}
+
+void FFPlayerPool::attach(FFPlayer *player) {
+    Q_D(FFPlayerPool);
+
+    QMutexLocker locker(&d->mutex);
+    if (!d->players.contains(player)) {
+        d->players.append(player);
+    }
+}
+
+void FFPlayerPool::detach(FFPlayer *player) {
+    Q_D(FFPlayerPool);
+
+    QMutexLocker locker(&d->mutex);
+    d->players.removeAll(player);
+}
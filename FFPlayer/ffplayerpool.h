@@ -0,0 +1,79 @@
+//
+//  ffplayerpool.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFPLAYERPOOL_H
+#define FFPLAYERPOOL_H
+
+#include <QObject>
+#include <QScopedPointer>
+
+#include "ffscheduler.h"
+
+class FFPlayer;
+class FFPlayerPoolPrivate;
+
+/**
+ * Runs the decode and convert stages of many players on a bounded set of
+ * workers.
+ *
+ * A player attached with FFPlayer::setPlayerPool() keeps one thread for
+ * its connection, which mostly sleeps in network reads. Decoding and
+ * converting are queued as short tasks per stream and run on the pool's
+ * workers by the player's priority, idle workers steal the tasks of busy
+ * ones. Players still attached are closed when the pool is destroyed.
+ */
+class FFPlayerPool : public QObject {
+    Q_OBJECT
+public:
+    // 0 starts one worker per core.
+    explicit FFPlayerPool(int threadCount = 0,
+                          QThread::Priority threadPriority = QThread::InheritPriority,
+                          QObject *parent = 0);
+    virtual ~FFPlayerPool();
+
+    int threadCount() const;
+    int playerCount() const;
+
+    // Tasks taken from the queue of another worker.
+    int stolenTaskCount() const;
+
+protected:
+    QScopedPointer<FFPlayerPoolPrivate> d_ptr;
+
+private:
+    friend class FFPlayer;
+    friend class FFPlayerPrivate;
+
+    FFScheduler *scheduler() const;
+    void attach(FFPlayer *player);
+    void detach(FFPlayer *player);
+
+    Q_DECLARE_PRIVATE(FFPlayerPool)
+    Q_DISABLE_COPY(FFPlayerPool)
+};
+
+#endif // FFPLAYERPOOL_H
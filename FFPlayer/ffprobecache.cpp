@@ -0,0 +1,194 @@
+//
+//  ffprobecache.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffprobecache.h"
+
+#include <cstring>
+
+#define DEFAULT_MAX_ENTRIES         64
+
+FFProbeCache::Entry::~Entry() {
+    for (int i = 0; i < streams.count(); i++) {
+        avcodec_parameters_free(&streams[i].parameters);
+    }
+}
+
+FFProbeCache::FFProbeCache() :
+    _entries(DEFAULT_MAX_ENTRIES),
+    _mutex(QMutex::NonRecursive) {
+
+}
+
+FFProbeCache *FFProbeCache::instance() {
+    static FFProbeCache sInstance;
+    return &sInstance;
+}
+
+static int64_t restoredTime(int64_t reported, int64_t cached, AVRational cachedBase, AVRational base) {
+    // What the header carries wins over the estimate of an earlier probe.
+    if (reported != AV_NOPTS_VALUE || cached == AV_NOPTS_VALUE) {
+        return reported;
+    }
+
+    return av_rescale_q(cached, cachedBase, base);
+}
+
+static bool isReportedMatching(const AVCodecParameters *reported, const AVCodecParameters *cached) {
+    if (reported->codec_type != cached->codec_type ||
+            (reported->codec_id != AV_CODEC_ID_NONE && reported->codec_id != cached->codec_id)) {
+        return false;
+    }
+
+    // Only what the header already reports, e.g. an RTSP SDP carries the
+    // SPS and PPS as extradata. Unknown fields are left to the cache.
+    if (reported->extradata_size > 0 &&
+            (reported->extradata_size != cached->extradata_size ||
+             memcmp(reported->extradata, cached->extradata, reported->extradata_size) != 0)) {
+        return false;
+    }
+
+    if ((reported->width > 0 && reported->width != cached->width) ||
+            (reported->height > 0 && reported->height != cached->height) ||
+            (reported->format >= 0 && reported->format != cached->format)) {
+        return false;
+    }
+
+    if ((reported->sample_rate > 0 && reported->sample_rate != cached->sample_rate) ||
+            (reported->channels > 0 && reported->channels != cached->channels)) {
+        return false;
+    }
+
+    return true;
+}
+
+void FFProbeCache::insert(const QString &url, const AVFormatContext *context) {
+    Entry *entry = new Entry();
+    entry->startTime = context->start_time;
+    entry->duration = context->duration;
+
+    for (unsigned int i = 0; i < context->nb_streams; i++) {
+        const AVStream *stream = context->streams[i];
+
+        StreamParameters streamParameters;
+        streamParameters.parameters = avcodec_parameters_alloc();
+        streamParameters.avgFrameRate = stream->avg_frame_rate;
+        streamParameters.realFrameRate = stream->r_frame_rate;
+        streamParameters.timeBase = stream->time_base;
+        streamParameters.startTime = stream->start_time;
+        streamParameters.duration = stream->duration;
+        entry->streams.append(streamParameters);
+
+        if (!streamParameters.parameters ||
+                avcodec_parameters_copy(streamParameters.parameters, stream->codecpar) < 0) {
+            delete entry;
+            return;
+        }
+    }
+
+    QMutexLocker locker(&_mutex);
+    _entries.insert(url, entry);
+}
+
+bool FFProbeCache::apply(const QString &url, AVFormatContext *context) {
+    QMutexLocker locker(&_mutex);
+
+    Entry *entry = _entries.object(url);
+    if (!entry || entry->streams.count() != static_cast<int>(context->nb_streams)) {
+        return false;
+    }
+
+    // The demuxer already knows the stream types, mostly the codecs and
+    // often more. A source that changed, e.g. a camera switched to another
+    // resolution, is probed again.
+    for (unsigned int i = 0; i < context->nb_streams; i++) {
+        if (!isReportedMatching(context->streams[i]->codecpar, entry->streams[i].parameters)) {
+            return false;
+        }
+    }
+
+    // Copied aside first, a failure must not leave the context half
+    // overwritten.
+    QList<AVCodecParameters *> parameters;
+    for (unsigned int i = 0; i < context->nb_streams; i++) {
+        AVCodecParameters *copy = avcodec_parameters_alloc();
+        if (!copy || avcodec_parameters_copy(copy, entry->streams[i].parameters) < 0) {
+            avcodec_parameters_free(&copy);
+            for (int j = 0; j < parameters.count(); j++) {
+                avcodec_parameters_free(&parameters[j]);
+            }
+            return false;
+        }
+
+        parameters.append(copy);
+    }
+
+    for (unsigned int i = 0; i < context->nb_streams; i++) {
+        AVStream *stream = context->streams[i];
+        const StreamParameters &cached = entry->streams[i];
+
+        avcodec_parameters_free(&stream->codecpar);
+        stream->codecpar = parameters[i];
+
+        // Keep the deprecated per-stream codec context in line as well.
+        // The decoder reads the parameters, a failure here is harmless.
+        avcodec_parameters_to_context(stream->codec, stream->codecpar);
+
+        stream->avg_frame_rate = cached.avgFrameRate;
+        stream->r_frame_rate = cached.realFrameRate;
+        stream->start_time = restoredTime(stream->start_time, cached.startTime,
+                                          cached.timeBase, stream->time_base);
+        stream->duration = restoredTime(stream->duration, cached.duration,
+                                        cached.timeBase, stream->time_base);
+    }
+
+    context->start_time = restoredTime(context->start_time, entry->startTime,
+                                       AV_TIME_BASE_Q, AV_TIME_BASE_Q);
+    context->duration = restoredTime(context->duration, entry->duration,
+                                     AV_TIME_BASE_Q, AV_TIME_BASE_Q);
+
+    return true;
+}
+
+void FFProbeCache::remove(const QString &url) {
+    QMutexLocker locker(&_mutex);
+    _entries.remove(url);
+}
+
+void FFProbeCache::clear() {
+    QMutexLocker locker(&_mutex);
+    _entries.clear();
+}
+
+int FFProbeCache::maxEntries() const {
+    QMutexLocker locker(&_mutex);
+    return _entries.maxCost();
+}
+
+void FFProbeCache::setMaxEntries(int maxEntries) {
+    QMutexLocker locker(&_mutex);
+    _entries.setMaxCost(qMax(1, maxEntries));
+}
@@ -0,0 +1,85 @@
+//
+//  ffprobecache.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFPROBECACHE_H
+#define FFPROBECACHE_H
+
+#include <QCache>
+#include <QMutex>
+#include <QString>
+
+#include "ffheaders.h"
+
+/**
+ * Process-wide cache of probed codec parameters, keyed by URL.
+ *
+ * A context opened again from the same URL takes its stream parameters
+ * from here instead of running avformat_find_stream_info(). Entries are
+ * only applied when the streams the demuxer reports still match. The
+ * start time and duration the probe estimated are restored where the
+ * header did not carry them, e.g. MPEG-TS or raw streams.
+ */
+class FFProbeCache {
+public:
+    static FFProbeCache *instance();
+
+    // Stores the parameters of a probed context.
+    void insert(const QString &url, const AVFormatContext *context);
+    // False if nothing is cached or the streams no longer match what the
+    // demuxer reports, the context is left untouched then.
+    bool apply(const QString &url, AVFormatContext *context);
+    void remove(const QString &url);
+    void clear();
+
+    int maxEntries() const;
+    void setMaxEntries(int maxEntries);
+
+private:
+    explicit FFProbeCache();
+    Q_DISABLE_COPY(FFProbeCache)
+
+    struct StreamParameters {
+        AVCodecParameters   *parameters;
+        AVRational          avgFrameRate;
+        AVRational          realFrameRate;
+        AVRational          timeBase;
+        int64_t             startTime;
+        int64_t             duration;
+    };
+
+    struct Entry {
+        ~Entry();
+        QList<StreamParameters> streams;
+        int64_t             startTime;      // AV_TIME_BASE
+        int64_t             duration;       // AV_TIME_BASE
+    };
+
+    QCache<QString, Entry> _entries;
+    mutable QMutex       _mutex;
+};
+
+#endif // FFPROBECACHE_H
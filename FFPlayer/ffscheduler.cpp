@@ -0,0 +1,270 @@
+//
+//  ffscheduler.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffscheduler.h"
+
+class FFScheduler::Worker : public QThread {
+public:
+    Worker(FFScheduler *scheduler, int index) :
+        _scheduler(scheduler),
+        _index(index) {
+
+    }
+
+protected:
+    void run() {
+        _scheduler->run(_index);
+    }
+
+private:
+    FFScheduler *_scheduler;
+    int          _index;
+};
+
+FFScheduler::FFScheduler(int threadCount, QThread::Priority threadPriority) :
+    _workers(),
+    _queues(),
+    _delayed(),
+    _timer(),
+    _nextQueue(0),
+    _stolen(0),
+    _pending(0),
+    _running(0),
+    _isStopping(false),
+    _mutex(QMutex::NonRecursive) {
+
+    _timer.start();
+
+    int count = threadCount > 0 ? threadCount : qMax(1, QThread::idealThreadCount());
+    for (int i = 0; i < count; i++) {
+        _queues.append(new RunQueue);
+    }
+
+    for (int i = 0; i < count; i++) {
+        Worker *worker = new Worker(this, i);
+        _workers.append(worker);
+        worker->start(threadPriority);
+    }
+}
+
+FFScheduler::~FFScheduler() {
+    {
+        QMutexLocker locker(&_mutex);
+        _isStopping = true;
+        _wakeup.wakeAll();
+    }
+
+    for (int i = 0; i < _workers.count(); i++) {
+        _workers[i]->wait();
+    }
+
+    qDeleteAll(_workers);
+    qDeleteAll(_queues);
+}
+
+void FFScheduler::schedule(const Task &task, Priority priority) {
+    // Tasks scheduled by a task stay with its worker until stolen.
+    int worker = currentWorker();
+    if (worker < 0) {
+        worker = (_nextQueue.fetchAndAddRelaxed(1) & 0x7fffffff) % _queues.count();
+    }
+
+    enqueue(worker, task, priority);
+}
+
+void FFScheduler::scheduleAfter(int msecs, const Task &task, Priority priority) {
+    if (msecs <= 0) {
+        schedule(task, priority);
+        return;
+    }
+
+    DelayedTask delayed;
+    delayed.task = task;
+    delayed.priority = priority;
+
+    QMutexLocker locker(&_mutex);
+    delayed.due = _timer.elapsed() + msecs;
+
+    int i = _delayed.count();
+    while (i > 0 && _delayed[i - 1].due > delayed.due) {
+        i--;
+    }
+    _delayed.insert(i, delayed);
+
+    // Sleeping workers wait for the earliest task only.
+    if (i == 0) {
+        _wakeup.wakeOne();
+    }
+}
+
+void FFScheduler::waitForDone() {
+    QMutexLocker locker(&_mutex);
+    while (_pending > 0 || _running > 0 || !_delayed.isEmpty()) {
+        _done.wait(&_mutex);
+    }
+}
+
+int FFScheduler::threadCount() const {
+    return _workers.count();
+}
+
+int FFScheduler::pendingCount() const {
+    QMutexLocker locker(&_mutex);
+    return qMax(0, _pending) + _delayed.count();
+}
+
+int FFScheduler::stolenCount() const {
+    return _stolen.load();
+}
+
+void FFScheduler::enqueue(int queue, const Task &task, Priority priority) {
+    {
+        QMutexLocker queueLock(&_queues[queue]->mutex);
+        _queues[queue]->tasks[priority].enqueue(task);
+    }
+
+    // Counted after the task is visible, a worker that finds the count
+    // raised also finds the task.
+    QMutexLocker locker(&_mutex);
+    _pending++;
+    _wakeup.wakeOne();
+}
+
+bool FFScheduler::take(int queue, Priority priority, bool isNewest, Task *task) {
+    RunQueue *runQueue = _queues[queue];
+
+    QMutexLocker queueLock(&runQueue->mutex);
+    QQueue<Task> &tasks = runQueue->tasks[priority];
+    if (tasks.isEmpty()) {
+        return false;
+    }
+
+    *task = isNewest ? tasks.takeLast() : tasks.dequeue();
+    return true;
+}
+
+bool FFScheduler::takeTask(int worker, Task *task) {
+    int count = _queues.count();
+
+    for (int priority = HighPriority; priority >= LowPriority; priority--) {
+        // Own tasks in order, the owner and the thieves take from opposite ends.
+        if (take(worker, static_cast<Priority>(priority), false, task)) {
+            return true;
+        }
+
+        for (int i = 1; i < count; i++) {
+            if (take((worker + i) % count, static_cast<Priority>(priority), true, task)) {
+                _stolen.ref();
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+int FFScheduler::queueDelayedLocked() {
+    qint64 now = _timer.elapsed();
+
+    while (!_delayed.isEmpty() && _delayed.first().due <= now) {
+        DelayedTask delayed = _delayed.takeFirst();
+
+        // Already due, ahead of the tasks of its priority.
+        int queue = (_nextQueue.fetchAndAddRelaxed(1) & 0x7fffffff) % _queues.count();
+        {
+            QMutexLocker queueLock(&_queues[queue]->mutex);
+            _queues[queue]->tasks[delayed.priority].prepend(delayed.task);
+        }
+
+        _pending++;
+        _wakeup.wakeOne();
+    }
+
+    return _delayed.isEmpty() ? -1 : static_cast<int>(_delayed.first().due - now);
+}
+
+int FFScheduler::currentWorker() const {
+    QThread *thread = QThread::currentThread();
+    for (int i = 0; i < _workers.count(); i++) {
+        if (_workers[i] == thread) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void FFScheduler::run(int worker) {
+    Task task;
+
+    forever {
+        if (takeTask(worker, &task)) {
+            {
+                QMutexLocker locker(&_mutex);
+                _pending--;
+                _running++;
+
+                // Busy workers never run dry, due tasks are queued on
+                // every dequeue or paced wakeups would starve.
+                queueDelayedLocked();
+            }
+
+            task();
+            // Release what the task holds before it counts as done.
+            task = Task();
+
+            QMutexLocker locker(&_mutex);
+            _running--;
+            if (_pending <= 0 && _running == 0 && _delayed.isEmpty()) {
+                _done.wakeAll();
+            }
+
+            if (_isStopping) {
+                return;
+            }
+
+            continue;
+        }
+
+        QMutexLocker locker(&_mutex);
+        if (_isStopping) {
+            return;
+        }
+
+        int timeout = queueDelayedLocked();
+        if (_pending > 0) {
+            continue;
+        }
+
+        if (timeout < 0) {
+            _wakeup.wait(&_mutex);
+        }
+        else {
+            _wakeup.wait(&_mutex, static_cast<unsigned long>(timeout));
+        }
+    }
+}
@@ -0,0 +1,117 @@
+//
+//  ffscheduler.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFSCHEDULER_H
+#define FFSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <functional>
+
+/**
+ * Bounded set of worker threads running short tasks.
+ *
+ * Every worker owns a run queue per priority. Tasks scheduled from a
+ * worker go to its own queue, tasks from other threads are spread over
+ * the workers. A worker runs its own tasks in order and, once they are
+ * done, steals the newest task of another worker. Higher priorities are
+ * taken first, from any queue. Tasks must not block, a blocked task holds
+ * its worker.
+ */
+class FFScheduler {
+public:
+    /** Run queue priority */
+    enum Priority {
+        LowPriority,
+        NormalPriority,
+        HighPriority
+    };
+
+    typedef std::function<void()> Task;
+
+    // 0 starts one worker per core.
+    explicit FFScheduler(int threadCount = 0,
+                         QThread::Priority threadPriority = QThread::InheritPriority);
+    // Stops the workers, pending and delayed tasks are dropped.
+    ~FFScheduler();
+
+    void schedule(const Task &task, Priority priority = NormalPriority);
+    // The task is queued once msecs have passed.
+    void scheduleAfter(int msecs, const Task &task, Priority priority = NormalPriority);
+
+    // Blocks until no task is queued, delayed or running.
+    void waitForDone();
+
+    int threadCount() const;
+    int pendingCount() const;
+    int stolenCount() const;
+
+private:
+    Q_DISABLE_COPY(FFScheduler)
+
+    class Worker;
+
+    struct RunQueue {
+        QQueue<Task>    tasks[HighPriority + 1];
+        QMutex          mutex;
+    };
+
+    struct DelayedTask {
+        qint64      due;
+        Task        task;
+        Priority    priority;
+    };
+
+    void enqueue(int queue, const Task &task, Priority priority);
+    bool take(int queue, Priority priority, bool isNewest, Task *task);
+    bool takeTask(int worker, Task *task);
+    int queueDelayedLocked();
+    int currentWorker() const;
+    void run(int worker);
+
+    QList<Worker *>      _workers;
+    QVector<RunQueue *>  _queues;
+    QList<DelayedTask>   _delayed;      // by due time
+    QElapsedTimer        _timer;
+    QAtomicInt           _nextQueue;
+    QAtomicInt           _stolen;
+    int                  _pending;
+    int                  _running;
+    bool                 _isStopping;
+
+    mutable QMutex       _mutex;
+    QWaitCondition       _wakeup;
+    QWaitCondition       _done;
+};
+
+#endif // FFSCHEDULER_H
@@ -0,0 +1,373 @@
+//
+//  ffsessionregistry.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffsessionregistry.h"
+
+#include <QStringList>
+#include <QtConcurrent>
+
+#include "ffplayer.h"
+
+static QString sessionKey(const QUrl &url, const FFPlayer *player) {
+    // Players share a session only when they would get the same frames.
+    FFDecoderOptions options = player->decoderOptions();
+
+    QStringList key;
+    key << url.toString()
+        << QString::number(options.outputFormat)
+        << QString::number(options.outputSize.width())
+        << QString::number(options.outputSize.height())
+        << QString::number(options.aspectRatioMode)
+        << QString::number(options.scaleQuality)
+        << QString::number(options.fastDecode)
+        << QString::number(options.lowDelay || player->isLowLatency())
+        << QString::number(options.decodeAudio)
+        << QString::number(player->isKeyframePreview())
+        << QString::number(player->keyframePreviewSize().width())
+        << QString::number(player->keyframePreviewSize().height());
+
+    if (options.decodeAudio) {
+        key << QString::number(options.audioSampleRate)
+            << QString::number(options.audioChannels)
+            << QString::number(options.audioSampleFormat);
+    }
+
+    return key.join('|');
+}
+
+/*
+ * FFSessionRegistry::Subscription
+ */
+FFSessionRegistry::Subscription::Subscription(FFPlayer *player) :
+    player(player),
+    isActive(true),
+    mutex(QMutex::Recursive) {
+
+}
+
+/*
+ * FFSessionRegistry
+ */
+FFSessionRegistry::FFSessionRegistry() :
+    _sessions(),
+    _subscriptions(),
+    _mutex(QMutex::Recursive),
+    _teardownPool() {
+
+}
+
+FFSessionRegistry *FFSessionRegistry::instance() {
+    static FFSessionRegistry sInstance;
+    return &sInstance;
+}
+
+int FFSessionRegistry::sessionCount() const {
+    QMutexLocker locker(&_mutex);
+    return _sessions.count();
+}
+
+int FFSessionRegistry::subscriberCount(const FFPlayer *player) const {
+    QMutexLocker locker(&_mutex);
+
+    Session *session = _subscriptions.value(player);
+    return session ? session->subscribers.count() : 0;
+}
+
+bool FFSessionRegistry::sessionStatistics(const FFPlayer *player, FFStatistics::Snapshot *snapshot) const {
+    QMutexLocker locker(&_mutex);
+
+    Session *session = _subscriptions.value(player);
+    if (!session) {
+        return false;
+    }
+
+    *snapshot = session->source->statistics();
+    return true;
+}
+
+void FFSessionRegistry::subscribe(FFPlayer *player, const QUrl &url) {
+    QString key = sessionKey(url, player);
+    bool isReopen = false;
+
+    QMutexLocker locker(&_mutex);
+
+    Session *session = _sessions.value(key);
+    if (!session) {
+        session = createSession(key, url, player);
+        _sessions.insert(key, session);
+        isReopen = true;
+    }
+    else if (session->isClosed) {
+        // Ended on its own, e.g. end of stream, start it over.
+        session->isClosed = false;
+        session->isOpened = false;
+        isReopen = true;
+    }
+
+    session->subscribers.append(SubscriptionPtr(new Subscription(player)));
+    _subscriptions.insert(player, session);
+
+    bool isOpened = session->isOpened;
+    FFPlayer *source = session->source;
+    locker.unlock();
+
+    if (isReopen) {
+        source->close();
+        source->open(url);
+    }
+    else if (isOpened) {
+        player->sharedSessionOpened();
+        updateState(player);
+    }
+}
+
+bool FFSessionRegistry::unsubscribe(FFPlayer *player) {
+    if (!detach(player)) {
+        return false;
+    }
+
+    player->sharedSessionClosed();
+    return true;
+}
+
+bool FFSessionRegistry::resubscribe(FFPlayer *player) {
+    QMutexLocker locker(&_mutex);
+
+    Session *session = _subscriptions.value(player);
+    if (!session) {
+        return false;
+    }
+
+    QUrl url = session->url;
+    QString key = session->key;
+    locker.unlock();
+
+    if (sessionKey(url, player) == key) {
+        return true;
+    }
+
+    // The player keeps its state, frames of the matching session follow
+    // once that one is open.
+    detach(player);
+    subscribe(player, url);
+    return true;
+}
+
+bool FFSessionRegistry::detach(FFPlayer *player) {
+    QMutexLocker locker(&_mutex);
+
+    Session *session = _subscriptions.take(player);
+    if (!session) {
+        return false;
+    }
+
+    SubscriptionPtr subscription;
+    for (int i = 0; i < session->subscribers.count(); i++) {
+        if (session->subscribers[i]->player == player) {
+            subscription = session->subscribers.takeAt(i);
+            break;
+        }
+    }
+
+    bool isLast = session->subscribers.isEmpty();
+    if (isLast) {
+        _sessions.remove(session->key);
+    }
+    else {
+        updateState(session->subscribers.first()->player);
+    }
+    locker.unlock();
+
+    // Waits for a delivery to the player in flight on another thread.
+    if (subscription) {
+        QMutexLocker subscriptionLock(&subscription->mutex);
+        subscription->isActive = false;
+    }
+
+    if (isLast) {
+        // Not inline, the last player may close from a delivery on a
+        // thread of the session, which close() would have to join. The
+        // source is a QObject of the thread that created it, deleted there.
+        QtConcurrent::run(&_teardownPool, [session]() {
+            session->source->close();
+            session->source->disconnect();
+            session->source->deleteLater();
+            delete session;
+        });
+    }
+
+    return true;
+}
+
+void FFSessionRegistry::updateState(FFPlayer *player) {
+    QMutexLocker locker(&_mutex);
+
+    Session *session = _subscriptions.value(player);
+    if (!session) {
+        return;
+    }
+
+    bool isPlaying = false;
+    for (int i = 0; i < session->subscribers.count(); i++) {
+        if (session->subscribers[i]->player->getState() == FFPlayer::PlayingState) {
+            isPlaying = true;
+            break;
+        }
+    }
+
+    if (isPlaying) {
+        session->source->play();
+    }
+    else {
+        session->source->pause();
+    }
+}
+
+bool FFSessionRegistry::seek(FFPlayer *player, double position, FFPlayer::SeekMode mode) {
+    QMutexLocker locker(&_mutex);
+
+    Session *session = _subscriptions.value(player);
+    if (!session) {
+        return false;
+    }
+
+    session->source->seek(position, mode);
+    return true;
+}
+
+FFSessionRegistry::Session *FFSessionRegistry::createSession(const QString &key, const QUrl &url,
+                                                             const FFPlayer *player) {
+    Session *session = new Session;
+    session->key = key;
+    session->url = url;
+    session->isOpened = false;
+    session->isClosed = false;
+
+    // The first player's settings open the session for all of them.
+    FFPlayer *source = new FFPlayer();
+    source->setDecoderOptions(player->decoderOptions());
+    source->setIsLowLatency(player->isLowLatency());
+    source->setCatchUpThreshold(player->catchUpThreshold());
+    source->setIsFramePacing(player->isFramePacing());
+    source->setIsKeyframePreview(player->isKeyframePreview());
+    source->setKeyframePreviewSize(player->keyframePreviewSize());
+    source->setIsNeedAutoReconnect(player->isNeedAutoReconnect());
+    source->setIsPausingNetwork(player->isPausingNetwork());
+    source->setProbeLimits(player->probeSize(), player->probeDuration());
+    source->setIsProbeCaching(player->isProbeCaching());
+    source->setPacketQueueLimits(player->packetQueueMaxPackets(), player->packetQueueMaxBytes());
+    source->setFrameQueueMaxFrames(player->frameQueueMaxFrames());
+    source->setPlayerPool(player->playerPool());
+    source->setPoolPriority(player->poolPriority());
+    session->source = source;
+
+    // Forwarded on the threads of the source, like its own signals.
+    QObject::connect(source, &FFPlayer::updateVideoFrame, source, [this, session](FFVideoFramePtr frame) {
+        forwardFrame(session, frame);
+    }, Qt::DirectConnection);
+    QObject::connect(source, &FFPlayer::updateAudioFrame, source, [this, session](FFAudioFramePtr frame) {
+        forwardFrame(session, frame);
+    }, Qt::DirectConnection);
+    QObject::connect(source, &FFPlayer::contentDidOpened, source, [this, session]() {
+        forwardOpened(session);
+    }, Qt::DirectConnection);
+    QObject::connect(source, &FFPlayer::contentDidClosed, source, [this, session]() {
+        forwardClosed(session);
+    }, Qt::DirectConnection);
+    QObject::connect(source, &FFPlayer::reconnected, source, [this, session](int attempts, int duration) {
+        forwardReconnected(session, attempts, duration);
+    }, Qt::DirectConnection);
+    QObject::connect(source, &FFPlayer::endOfStream, source, [this, session]() {
+        forwardToSubscribers(session, [](FFPlayer *player) {
+            emit(player->endOfStream());
+        });
+    }, Qt::DirectConnection);
+
+    return session;
+}
+
+void FFSessionRegistry::forwardToSubscribers(Session *session,
+                                             const std::function<void(FFPlayer *)> &forward) {
+    // A copy, delivered without the registry lock so sessions and calls
+    // of the players do not wait on each other.
+    QList<SubscriptionPtr> subscribers;
+    {
+        QMutexLocker locker(&_mutex);
+        subscribers = session->subscribers;
+    }
+
+    for (int i = 0; i < subscribers.count(); i++) {
+        QMutexLocker subscriptionLock(&subscribers[i]->mutex);
+        if (subscribers[i]->isActive) {
+            forward(subscribers[i]->player);
+        }
+    }
+}
+
+void FFSessionRegistry::forwardFrame(Session *session, const FFFramePtr &frame) {
+    forwardToSubscribers(session, [&frame](FFPlayer *player) {
+        player->deliverSharedFrame(frame);
+    });
+}
+
+void FFSessionRegistry::forwardOpened(Session *session) {
+    FFPlayer *player = 0;
+    {
+        QMutexLocker locker(&_mutex);
+        session->isOpened = true;
+        if (!session->subscribers.isEmpty()) {
+            player = session->subscribers.first()->player;
+        }
+    }
+
+    forwardToSubscribers(session, [](FFPlayer *player) {
+        player->sharedSessionOpened();
+    });
+
+    // Players moved here while playing keep playing.
+    if (player) {
+        updateState(player);
+    }
+}
+
+void FFSessionRegistry::forwardClosed(Session *session) {
+    {
+        QMutexLocker locker(&_mutex);
+        session->isOpened = false;
+        session->isClosed = true;
+    }
+
+    forwardToSubscribers(session, [](FFPlayer *player) {
+        player->sharedSessionClosed();
+    });
+}
+
+void FFSessionRegistry::forwardReconnected(Session *session, int attempts, int duration) {
+    forwardToSubscribers(session, [attempts, duration](FFPlayer *player) {
+        emit(player->reconnected(attempts, duration));
+    });
+}
@@ -0,0 +1,126 @@
+//
+//  ffsessionregistry.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFSESSIONREGISTRY_H
+#define FFSESSIONREGISTRY_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+#include <QUrl>
+
+#include <functional>
+
+#include "ffplayer.h"
+
+/**
+ * Process-wide registry of sessions shared by several players.
+ *
+ * Players with session sharing enabled that open the same URL with the
+ * same output options attach to one hidden player: one connection, one
+ * decode, and every frame goes out to all of them as the same shared
+ * frame. The hidden player is closed when the last of them closes.
+ *
+ * Deliveries run on the threads of the hidden player, outside the lock
+ * of the registry. A player is detached once no delivery to it is in
+ * flight. The last one to close hands the hidden player to a thread of
+ * the registry, which closes it and leaves its deletion to the thread it
+ * lives on.
+ */
+class FFSessionRegistry {
+public:
+    static FFSessionRegistry *instance();
+
+    int sessionCount() const;
+    // Players attached to the session of the player, 0 if it has none.
+    int subscriberCount(const FFPlayer *player) const;
+
+private:
+    friend class FFPlayer;
+
+    explicit FFSessionRegistry();
+    Q_DISABLE_COPY(FFSessionRegistry)
+
+    struct Subscription {
+        explicit Subscription(FFPlayer *player);
+
+        FFPlayer            *player;
+        bool                isActive;
+        // Held while delivering, recursive as players may close from
+        // their own delivery.
+        QMutex              mutex;
+    };
+    typedef QSharedPointer<Subscription> SubscriptionPtr;
+
+    struct Session {
+        QString             key;
+        QUrl                url;
+        FFPlayer            *source;
+        QList<SubscriptionPtr> subscribers;
+        bool                isOpened;
+        bool                isClosed;
+    };
+
+    void subscribe(FFPlayer *player, const QUrl &url);
+    // False if the player was not attached to a session.
+    bool unsubscribe(FFPlayer *player);
+    // Moves the player to the session matching its settings now, e.g.
+    // after a keyframe preview toggle, without closing it. False if the
+    // player was not attached to a session.
+    bool resubscribe(FFPlayer *player);
+    // Plays the session while any of its players plays.
+    void updateState(FFPlayer *player);
+    // False if the player was not attached to a session.
+    bool seek(FFPlayer *player, double position, FFPlayer::SeekMode mode);
+    // Statistics of the hidden player, false if the player was not
+    // attached to a session.
+    bool sessionStatistics(const FFPlayer *player, FFStatistics::Snapshot *snapshot) const;
+
+    // Detaches the player without notifying it.
+    bool detach(FFPlayer *player);
+    Session *createSession(const QString &key, const QUrl &url, const FFPlayer *player);
+    void forwardToSubscribers(Session *session, const std::function<void(FFPlayer *)> &forward);
+    void forwardFrame(Session *session, const FFFramePtr &frame);
+    void forwardOpened(Session *session);
+    void forwardClosed(Session *session);
+    void forwardReconnected(Session *session, int attempts, int duration);
+
+    QHash<QString, Session *>     _sessions;
+    QHash<const FFPlayer *, Session *> _subscriptions;
+
+    // Guards the sessions and their subscriber lists, never held while
+    // delivering. Recursive, unsubscribe() updates the session state.
+    mutable QMutex       _mutex;
+
+    // Closes the hidden players of ended sessions, never the global pool.
+    QThreadPool          _teardownPool;
+};
+
+#endif // FFSESSIONREGISTRY_H
@@ -0,0 +1,276 @@
+//
+//  ffstatistics.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffstatistics.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+
+#define TRACE_MAX_EVENTS            65536        // about 2 MB of events
+#define BITRATE_WINDOW              1000000000   // nsecs
+
+static const char *const stageNames[FFStatistics::StageCount] = {
+    "read", "decode", "convert", "copy", "emit"
+};
+
+static int bucketIndex(qint64 nsecs) {
+    qint64 usecs = nsecs / 1000;
+
+    int index = 0;
+    while (usecs > 0 && index < FFStatistics::BucketCount - 1) {
+        usecs >>= 1;
+        index++;
+    }
+
+    return index;
+}
+
+static QElapsedTimer startedTimer() {
+    QElapsedTimer timer;
+    timer.start();
+    return timer;
+}
+
+/*
+ * FFStatistics::Timing
+ */
+FFStatistics::Timing::Timing() :
+    count(0),
+    totalNsecs(0),
+    maxNsecs(0) {
+
+    for (int i = 0; i < BucketCount; i++) {
+        buckets[i] = 0;
+    }
+}
+
+double FFStatistics::Timing::averageMsecs() const {
+    return count > 0 ? totalNsecs / 1000000.0 / count : 0.0;
+}
+
+double FFStatistics::Timing::percentileMsecs(double percentile) const {
+    if (count <= 0) {
+        return 0.0;
+    }
+
+    qint64 rank = qMax<qint64>(1, static_cast<qint64>(count * qBound(0.0, percentile, 100.0) / 100.0));
+    qint64 counted = 0;
+
+    for (int i = 0; i < BucketCount - 1; i++) {
+        counted += buckets[i];
+        if (counted >= rank) {
+            return (1 << i) / 1000.0;
+        }
+    }
+
+    return maxNsecs / 1000000.0;
+}
+
+/*
+ * FFStatistics::Snapshot
+ */
+FFStatistics::Snapshot::Snapshot() :
+    decodedFrames(0),
+    droppedFrames(0),
+    deliveredFrames(0),
+    packetsRead(0),
+    bytesRead(0),
+    bitrate(0),
+    packetQueueDepth(0),
+    packetQueueBytes(0),
+    frameQueueDepth(0),
+    reconnectCount(0),
+    reconnectAttemptCount(0) {
+
+}
+
+/*
+ * FFStatistics
+ */
+FFStatistics::FFStatistics() :
+    _windowStarted(0),
+    _windowBytes(0),
+    _traceNext(0),
+    _traceMutex(QMutex::NonRecursive) {
+
+}
+
+FFStatistics::~FFStatistics() {
+
+}
+
+qint64 FFStatistics::timestamp() {
+    static const QElapsedTimer timer = startedTimer();
+    return timer.nsecsElapsed();
+}
+
+void FFStatistics::record(Stage stage, qint64 started) {
+    qint64 duration = timestamp() - started;
+    StageCounters &counters = _stages[stage];
+
+    counters.count.fetchAndAddRelaxed(1);
+    counters.totalNsecs.fetchAndAddRelaxed(duration);
+    counters.buckets[bucketIndex(duration)].fetchAndAddRelaxed(1);
+
+    qint64 maxNsecs = counters.maxNsecs.load();
+    while (duration > maxNsecs && !counters.maxNsecs.testAndSetRelaxed(maxNsecs, duration)) {
+        maxNsecs = counters.maxNsecs.load();
+    }
+
+    if (_isTracing.load()) {
+        appendTraceEvent(stage, started, duration);
+    }
+}
+
+void FFStatistics::recordRead(qint64 started, int bytes) {
+    record(StageRead, started);
+
+    _packetsRead.fetchAndAddRelaxed(1);
+    _bytesRead.fetchAndAddRelaxed(bytes);
+
+    qint64 now = timestamp();
+    if (_windowStarted == 0) {
+        _windowStarted = now;
+    }
+
+    _windowBytes += bytes;
+
+    qint64 window = now - _windowStarted;
+    if (window >= BITRATE_WINDOW) {
+        _bitrate.store(_windowBytes * 8 * 1000000000LL / window);
+        _windowStarted = now;
+        _windowBytes = 0;
+    }
+}
+
+void FFStatistics::addDecodedFrames(int count) {
+    _decodedFrames.fetchAndAddRelaxed(count);
+}
+
+void FFStatistics::addDeliveredFrames(int count) {
+    _deliveredFrames.fetchAndAddRelaxed(count);
+}
+
+FFStatistics::Snapshot FFStatistics::snapshot() const {
+    Snapshot snapshot;
+
+    for (int i = 0; i < StageCount; i++) {
+        const StageCounters &counters = _stages[i];
+        Timing &timing = snapshot.stages[i];
+
+        // Not one atomic snapshot, the fields may be a record apart.
+        timing.count = counters.count.load();
+        timing.totalNsecs = counters.totalNsecs.load();
+        timing.maxNsecs = counters.maxNsecs.load();
+        for (int j = 0; j < BucketCount; j++) {
+            timing.buckets[j] = counters.buckets[j].load();
+        }
+    }
+
+    snapshot.decodedFrames = _decodedFrames.load();
+    snapshot.deliveredFrames = _deliveredFrames.load();
+    snapshot.packetsRead = _packetsRead.load();
+    snapshot.bytesRead = _bytesRead.load();
+    snapshot.bitrate = _bitrate.load();
+
+    return snapshot;
+}
+
+bool FFStatistics::isTracing() const {
+    return _isTracing.load();
+}
+
+void FFStatistics::setIsTracing(bool isTracing) {
+    QMutexLocker locker(&_traceMutex);
+
+    // Every enable starts a new trace.
+    if (isTracing && !_isTracing.load()) {
+        _traceEvents.clear();
+        _traceEvents.reserve(TRACE_MAX_EVENTS);
+        _traceNext = 0;
+    }
+
+    _isTracing.store(isTracing);
+}
+
+void FFStatistics::appendTraceEvent(Stage stage, qint64 started, qint64 duration) {
+    TraceEvent event;
+    event.started = started;
+    event.duration = duration;
+    event.thread = static_cast<qint64>(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    event.stage = stage;
+
+    QMutexLocker locker(&_traceMutex);
+    if (_traceEvents.count() < TRACE_MAX_EVENTS) {
+        _traceEvents.append(event);
+    }
+    else {
+        _traceEvents[_traceNext] = event;
+        _traceNext = (_traceNext + 1) % TRACE_MAX_EVENTS;
+    }
+}
+
+QByteArray FFStatistics::traceEvents() const {
+    QVector<TraceEvent> events;
+    int next = 0;
+    {
+        QMutexLocker locker(&_traceMutex);
+        events = _traceEvents;
+        next = _traceNext;
+    }
+
+    QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+
+    QByteArray json;
+    json.reserve(events.count() * 96 + 64);
+    json.append("{\"traceEvents\":[");
+
+    // Complete events, timestamps in usecs. Oldest first once the ring wrapped.
+    for (int i = 0; i < events.count(); i++) {
+        const TraceEvent &event = events[(next + i) % events.count()];
+
+        if (i > 0) {
+            json.append(',');
+        }
+
+        json.append("\n{\"name\":\"");
+        json.append(stageNames[event.stage]);
+        json.append("\",\"cat\":\"ffplayer\",\"ph\":\"X\",\"ts\":");
+        json.append(QByteArray::number(event.started / 1000.0, 'f', 3));
+        json.append(",\"dur\":");
+        json.append(QByteArray::number(event.duration / 1000.0, 'f', 3));
+        json.append(",\"pid\":");
+        json.append(pid);
+        json.append(",\"tid\":");
+        json.append(QByteArray::number(event.thread));
+        json.append('}');
+    }
+
+    json.append("\n],\"displayTimeUnit\":\"ms\"}\n");
+    return json;
+}
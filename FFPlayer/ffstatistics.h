@@ -0,0 +1,150 @@
+//
+//  ffstatistics.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFSTATISTICS_H
+#define FFSTATISTICS_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QMutex>
+#include <QVector>
+
+/**
+ * Pipeline statistics of a player, cheap enough to stay on.
+ *
+ * Every stage records its durations into a log2 histogram of relaxed
+ * atomic counters, any thread may record. Trace events of the stages
+ * are only kept while tracing is enabled, in a bounded ring exported in
+ * the Chrome trace event format (chrome://tracing, Perfetto).
+ */
+class FFStatistics {
+public:
+    enum Stage {
+        StageRead,              // av_read_frame()
+        StageDecode,            // video codec
+        StageConvert,           // swscale
+        StageCopy,              // output buffers and plane references handed to the next stage
+        StageEmit,              // signal or ring delivery to the consumer
+        StageCount
+    };
+
+    // Bucket 0 counts durations below 1 usec, bucket i below 2^i usecs,
+    // the last one also the longer ones.
+    enum {
+        BucketCount = 22
+    };
+
+    struct Timing {
+        Timing();
+
+        qint64      count;
+        qint64      totalNsecs;
+        qint64      maxNsecs;
+        qint64      buckets[BucketCount];
+
+        double averageMsecs() const;
+        // Upper bound of the bucket holding the percentile, 0-100.
+        double percentileMsecs(double percentile) const;
+    };
+
+    struct Snapshot {
+        Snapshot();
+
+        Timing      stages[StageCount];
+
+        qint64      decodedFrames;          // video
+        qint64      droppedFrames;          // late, caught up and skipped
+        qint64      deliveredFrames;        // video
+        qint64      packetsRead;
+        qint64      bytesRead;
+        qint64      bitrate;                // bits/sec of the last second read
+
+        int         packetQueueDepth;
+        int         packetQueueBytes;
+        int         frameQueueDepth;
+        int         reconnectCount;
+        int         reconnectAttemptCount;
+    };
+
+    explicit FFStatistics();
+    ~FFStatistics();
+
+    // Monotonic nsecs shared by all instances, start stamp of record().
+    static qint64 timestamp();
+
+    void record(Stage stage, qint64 started);
+    // Demux thread only.
+    void recordRead(qint64 started, int bytes);
+    void addDecodedFrames(int count);
+    void addDeliveredFrames(int count);
+
+    // Counters and histograms, the player adds its queues and counters.
+    Snapshot snapshot() const;
+
+    bool isTracing() const;
+    void setIsTracing(bool isTracing);
+    // The last recorded events, empty unless tracing was enabled.
+    QByteArray traceEvents() const;
+
+private:
+    Q_DISABLE_COPY(FFStatistics)
+
+    struct StageCounters {
+        QAtomicInteger<qint64> count;
+        QAtomicInteger<qint64> totalNsecs;
+        QAtomicInteger<qint64> maxNsecs;
+        QAtomicInteger<qint64> buckets[BucketCount];
+    };
+
+    struct TraceEvent {
+        qint64      started;
+        qint64      duration;
+        qint64      thread;
+        int         stage;
+    };
+
+    void appendTraceEvent(Stage stage, qint64 started, qint64 duration);
+
+    StageCounters        _stages[StageCount];
+
+    QAtomicInteger<qint64> _decodedFrames;
+    QAtomicInteger<qint64> _deliveredFrames;
+    QAtomicInteger<qint64> _packetsRead;
+    QAtomicInteger<qint64> _bytesRead;
+    QAtomicInteger<qint64> _bitrate;
+
+    // Bitrate window, demux thread only.
+    qint64               _windowStarted;
+    qint64               _windowBytes;
+
+    QAtomicInt           _isTracing;
+    QVector<TraceEvent>  _traceEvents;      // ring
+    int                  _traceNext;
+    mutable QMutex       _traceMutex;
+};
+
+#endif // FFSTATISTICS_H
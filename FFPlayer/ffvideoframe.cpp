@@ -27,7 +27,13 @@
 
 #include "ffvideoframe.h"
 
-FFVideoFrame::FFVideoFrame() {
+#include "ffheaders.h"
+
+FFVideoFrame::FFVideoFrame():
+    pixelFormat(PixelFormatRGB888),
+    width(0),
+    height(0),
+    fps(0.0f) {
 
 }
 
@@ -39,3 +45,18 @@ FFFrame::FFFrameType FFVideoFrame::getFrameType() {
     return FFFrame::FFFrameTypeVideo;
 }
 
+const uchar *FFVideoFrame::planeData(int plane) const {
+    if (!avFrame || plane < 0 || plane >= AV_NUM_DATA_POINTERS) {
+        return 0;
+    }
+
+    return avFrame->data[plane];
+}
+
+int FFVideoFrame::planeLinesize(int plane) const {
+    if (!avFrame || plane < 0 || plane >= AV_NUM_DATA_POINTERS) {
+        return 0;
+    }
+
+    return avFrame->linesize[plane];
+}
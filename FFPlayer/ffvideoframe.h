@@ -34,17 +34,46 @@
 
 #include "ffframe.h"
 
+struct AVFrame;
+
 class FFVideoFrame: public FFFrame {
 public:
+    /** Output pixel format */
+    typedef enum {
+        PixelFormatRGB888,
+        PixelFormatRGB32,
+        PixelFormatARGB32Premultiplied,
+        PixelFormatGrayscale8,
+        PixelFormatYUV              // decoded planes, no conversion
+    } PixelFormat;
+
+    /** Scaler quality used when the output size differs from the source */
+    typedef enum {
+        ScaleQualityFast,           // fast bilinear
+        ScaleQualityBilinear,
+        ScaleQualityBicubic,
+        ScaleQualityArea,
+        ScaleQualityPoint
+    } ScaleQuality;
+
     explicit FFVideoFrame();
     virtual ~FFVideoFrame();
 
+    // Converted picture, null for PixelFormatYUV.
     QSharedPointer<QImage> image;
 
+    // Reference to the decoded planes, set for PixelFormatYUV.
+    QSharedPointer<AVFrame> avFrame;
+
+    PixelFormat pixelFormat;
+
     int width;
     int height;
     float fps;
 
+    const uchar *planeData(int plane) const;
+    int planeLinesize(int plane) const;
+
     // FFFrame interface
 public:
     virtual FFFrameType getFrameType();
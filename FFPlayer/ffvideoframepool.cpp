@@ -0,0 +1,186 @@
+//
+//  ffvideoframepool.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include "ffvideoframepool.h"
+
+#include <QMutex>
+#include <QVector>
+#include <QWeakPointer>
+
+#include "ffheaders.h"
+
+#define POOL_LINE_ALIGN             64           // bytes
+
+struct FFPoolBuffer {
+    uchar                                   *data;
+    int                                     generation;
+    QWeakPointer<FFVideoFramePoolPrivate>   pool;
+};
+
+class FFVideoFramePoolPrivate {
+public:
+    explicit FFVideoFramePoolPrivate(int capacity) :
+        capacity(capacity),
+        width(0),
+        height(0),
+        bytesPerLine(0),
+        format(QImage::Format_Invalid),
+        generation(0),
+        hits(0),
+        misses(0)
+    { }
+
+    ~FFVideoFramePoolPrivate() {
+        releaseFreeBuffers();
+    }
+
+    void releaseFreeBuffers() {
+        for (int i = 0; i < freeBuffers.count(); i++) {
+            av_free(freeBuffers[i]->data);
+            delete freeBuffers[i];
+        }
+        freeBuffers.clear();
+    }
+
+public:
+    QMutex                  mutex;
+    QVector<FFPoolBuffer *> freeBuffers;
+
+    int                     capacity;
+    int                     width;
+    int                     height;
+    int                     bytesPerLine;
+    QImage::Format          format;
+    int                     generation;
+
+    quint64                 hits;
+    quint64                 misses;
+};
+
+// Called by QImage when the last copy of a pooled image is destroyed.
+static void releasePoolBuffer(void *info) {
+    FFPoolBuffer *buffer = static_cast<FFPoolBuffer *>(info);
+
+    QSharedPointer<FFVideoFramePoolPrivate> pool = buffer->pool.toStrongRef();
+    if (pool) {
+        QMutexLocker locker(&pool->mutex);
+        if (buffer->generation == pool->generation &&
+                pool->freeBuffers.count() < pool->capacity) {
+            pool->freeBuffers.append(buffer);
+            return;
+        }
+    }
+
+    // Pool is gone, full or the buffer has an outdated size.
+    av_free(buffer->data);
+    delete buffer;
+}
+
+FFVideoFramePool::FFVideoFramePool(int capacity) :
+    d(new FFVideoFramePoolPrivate(capacity)) {
+
+}
+
+FFVideoFramePool::~FFVideoFramePool() {
+
+}
+
+QSharedPointer<QImage> FFVideoFramePool::acquire(int width, int height, QImage::Format format) {
+    FFPoolBuffer *buffer = 0;
+    int bytesPerLine = 0;
+
+    {
+        QMutexLocker locker(&d->mutex);
+
+        // Stream resolution or format changed, drop buffers of the old size.
+        if (width != d->width || height != d->height || format != d->format) {
+            d->releaseFreeBuffers();
+            d->width = width;
+            d->height = height;
+            d->format = format;
+            d->bytesPerLine = FFALIGN((width * QImage::toPixelFormat(format).bitsPerPixel() + 7) / 8,
+                                      POOL_LINE_ALIGN);
+            d->generation++;
+        }
+
+        bytesPerLine = d->bytesPerLine;
+
+        if (!d->freeBuffers.isEmpty()) {
+            buffer = d->freeBuffers.takeLast();
+            d->hits++;
+        }
+        else {
+            buffer = new FFPoolBuffer;
+            buffer->data = 0;
+            buffer->generation = d->generation;
+            buffer->pool = d;
+            d->misses++;
+        }
+    }
+
+    if (!buffer->data) {
+        buffer->data = static_cast<uchar *>(av_malloc(bytesPerLine * height));
+        if (!buffer->data) {
+            delete buffer;
+            return QSharedPointer<QImage>();
+        }
+    }
+
+    return QSharedPointer<QImage>(new QImage(buffer->data, width, height, bytesPerLine,
+                                             format, releasePoolBuffer, buffer));
+}
+
+int FFVideoFramePool::capacity() const {
+    QMutexLocker locker(&d->mutex);
+    return d->capacity;
+}
+
+void FFVideoFramePool::setCapacity(int capacity) {
+    QMutexLocker locker(&d->mutex);
+    d->capacity = capacity;
+
+    while (d->freeBuffers.count() > d->capacity) {
+        FFPoolBuffer *buffer = d->freeBuffers.takeLast();
+        av_free(buffer->data);
+        delete buffer;
+    }
+}
+
+void FFVideoFramePool::clear() {
+    QMutexLocker locker(&d->mutex);
+    d->releaseFreeBuffers();
+}
+
+quint64 FFVideoFramePool::hitCount() const {
+    QMutexLocker locker(&d->mutex);
+    return d->hits;
+}
+
+quint64 FFVideoFramePool::missCount() const {
+    QMutexLocker locker(&d->mutex);
+    return d->misses;
+}
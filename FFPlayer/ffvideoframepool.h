@@ -0,0 +1,62 @@
+//
+//  ffvideoframepool.h
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#ifndef FFVIDEOFRAMEPOOL_H
+#define FFVIDEOFRAMEPOOL_H
+
+#include <QImage>
+#include <QSharedPointer>
+
+class FFVideoFramePoolPrivate;
+
+/**
+ * Bounded pool of pre-sized image buffers.
+ *
+ * Images returned by acquire() wrap a pooled buffer; the buffer goes back
+ * to the pool when the last copy of the image is destroyed. Copies of
+ * FFVideoFramePool share the same pool.
+ */
+class FFVideoFramePool {
+public:
+    explicit FFVideoFramePool(int capacity = 8);
+    ~FFVideoFramePool();
+
+    QSharedPointer<QImage> acquire(int width, int height, QImage::Format format);
+
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    void clear();
+
+    quint64 hitCount() const;
+    quint64 missCount() const;
+
+private:
+    QSharedPointer<FFVideoFramePoolPrivate> d;
+};
+
+#endif // FFVIDEOFRAMEPOOL_H
@@ -0,0 +1,38 @@
+#
+#  ffbenchmark.pro
+#  FFPlayer
+#
+#  Demux, decode and conversion throughput, allocations, peak RSS and
+#  time to first frame over synthetic media generated with ffmpeg.
+#
+#  qmake && make && ./ffbenchmark --output results.json
+#
+#  FFmpeg is found with pkg-config, or set FFMPEG_DIR to a build made
+#  with the scripts: qmake FFMPEG_DIR=/path/to/ffmpeg
+#
+
+QT       += core gui concurrent
+QT       -= widgets
+
+CONFIG   += c++11 console
+CONFIG   -= app_bundle
+
+TARGET = ffbenchmark
+TEMPLATE = app
+
+FFPLAYER_DIR = $$PWD/../../FFPlayer
+
+INCLUDEPATH += $$FFPLAYER_DIR
+
+SOURCES += main.cpp \
+    $$files($$FFPLAYER_DIR/*.cpp)
+
+HEADERS += $$files($$FFPLAYER_DIR/*.h)
+
+isEmpty(FFMPEG_DIR) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libavformat libavcodec libswscale libswresample libavutil
+} else {
+    INCLUDEPATH += $$FFMPEG_DIR/include
+    LIBS += -L$$FFMPEG_DIR/lib -lavformat -lavcodec -lswscale -lswresample -lavutil
+}
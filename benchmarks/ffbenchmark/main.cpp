@@ -0,0 +1,433 @@
+//
+//  main.cpp
+//  FFPlayer
+//
+//  The MIT License (MIT)
+//
+//  Copyright (c) 2016 Alexander Borovikov
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy
+//  of this software and associated documentation files (the "Software"), to deal
+//  in the Software without restriction, including without limitation the rights
+//  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//  copies of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//  SOFTWARE.
+//
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QSysInfo>
+#include <QThread>
+#include <QTimer>
+
+#include <cstdlib>
+#include <new>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "ffheaders.h"
+#include "ffdecoder.h"
+#include "ffplayer.h"
+
+#define DEFAULT_DURATION            10           // sec. of generated media
+#define DEFAULT_FRAME_RATE          30
+#define DEFAULT_GOP_SIZE            60
+#define OPEN_TIMEOUT                30000        // msecs
+
+/*
+ * Allocation counter, every C++ allocation of the process. FFmpeg and
+ * image buffers are allocated with malloc, the frame pool misses count
+ * those of the images.
+ */
+static QAtomicInteger<quint64> sAllocations(0);
+
+void *operator new(std::size_t size) {
+    sAllocations.ref();
+
+    void *pointer = std::malloc(size ? size : 1);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+struct MediaSpec {
+    QString     codec;
+    QString     encoder;
+    QString     container;
+    QStringList encoderArguments;
+};
+
+static QList<MediaSpec> mediaSpecs() {
+    QList<MediaSpec> specs;
+
+    MediaSpec h264 = { "h264", "libx264", "mp4", QStringList() << "-preset" << "veryfast" };
+    MediaSpec hevc = { "hevc", "libx265", "mp4", QStringList() << "-preset" << "veryfast" };
+    MediaSpec vp9 = { "vp9", "libvpx-vp9", "webm",
+                      QStringList() << "-deadline" << "realtime" << "-cpu-used" << "8" };
+    MediaSpec mpeg4 = { "mpeg4", "mpeg4", "mp4", QStringList() << "-q:v" << "4" };
+
+    specs << h264 << hevc << vp9 << mpeg4;
+    return specs;
+}
+
+static qint64 peakRss() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) < 0) {
+        return -1;
+    }
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss;                 // bytes
+#else
+    return usage.ru_maxrss * 1024LL;        // KB
+#endif
+#else
+    return -1;
+#endif
+}
+
+static double perSecond(qint64 count, qint64 nsecs) {
+    return nsecs > 0 ? count * 1000000000.0 / nsecs : 0.0;
+}
+
+static QString generateMedia(const QString &ffmpeg, const QString &directory,
+                             const MediaSpec &spec, const QSize &size, int duration) {
+    QString path = QDir(directory).filePath(QString("%1_%2x%3_%4s.%5")
+                                            .arg(spec.codec)
+                                            .arg(size.width())
+                                            .arg(size.height())
+                                            .arg(duration)
+                                            .arg(spec.container));
+
+    // Generated once, later runs compare against the same input.
+    if (QFileInfo(path).size() > 0) {
+        return path;
+    }
+
+    QStringList arguments;
+    arguments << "-y" << "-v" << "error"
+              << "-f" << "lavfi"
+              << "-i" << QString("testsrc2=size=%1x%2:rate=%3:duration=%4")
+                         .arg(size.width()).arg(size.height()).arg(DEFAULT_FRAME_RATE).arg(duration)
+              << "-c:v" << spec.encoder
+              << "-g" << QString::number(DEFAULT_GOP_SIZE)
+              << "-pix_fmt" << "yuv420p"
+              << spec.encoderArguments
+              << path;
+
+    QProcess process;
+    process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    process.start(ffmpeg, arguments);
+
+    if (!process.waitForFinished(-1) || process.exitStatus() != QProcess::NormalExit ||
+            process.exitCode() != 0) {
+        QFile::remove(path);
+        return QString();
+    }
+
+    return path;
+}
+
+static AVFormatContext *openInput(const QString &path) {
+    AVFormatContext *formatContext = 0;
+    if (avformat_open_input(&formatContext, path.toUtf8().constData(), 0, 0) < 0) {
+        return 0;
+    }
+
+    if (avformat_find_stream_info(formatContext, NULL) < 0) {
+        avformat_close_input(&formatContext);
+        return 0;
+    }
+
+    return formatContext;
+}
+
+// Demux only, then demux, decode and convert every frame.
+static QJsonObject benchmarkPipeline(const QString &path, const FFDecoderOptions &options) {
+    QJsonObject result;
+
+    AVFormatContext *formatContext = openInput(path);
+    if (!formatContext) {
+        result["error"] = QString("open failed");
+        return result;
+    }
+
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = NULL;
+    packet.size = 0;
+
+    qint64 packets = 0;
+    qint64 bytes = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while (av_read_frame(formatContext, &packet) >= 0) {
+        packets++;
+        bytes += packet.size;
+        av_packet_unref(&packet);
+    }
+
+    qint64 demuxNsecs = timer.nsecsElapsed();
+    avformat_close_input(&formatContext);
+
+    // Again from the start, with a decoder.
+    formatContext = openInput(path);
+    if (!formatContext) {
+        result["error"] = QString("reopen failed");
+        return result;
+    }
+
+    FFDecoder decoder(formatContext, options);
+    FFVideoFramePool framePool = decoder.framePool();
+
+    int streamIndex = decoder.videoStreamIndex();
+    if (streamIndex >= 0) {
+        AVCodecParameters *parameters = formatContext->streams[streamIndex]->codecpar;
+        result["width"] = parameters->width;
+        result["height"] = parameters->height;
+        result["codec"] = QString(avcodec_get_name(parameters->codec_id));
+    }
+
+    qint64 frames = 0;
+    qint64 decodeNsecs = 0;
+    qint64 convertNsecs = 0;
+    quint64 allocations = sAllocations.load();
+    quint64 imageAllocations = framePool.missCount();
+
+    bool isEndOfStream = false;
+    while (!isEndOfStream) {
+        QList<FFFramePtr> decoded;
+
+        // Reading and other streams are the demux figures, not decoding.
+        if (av_read_frame(formatContext, &packet) < 0) {
+            isEndOfStream = true;
+
+            timer.start();
+            decoded = decoder.drainFrames(false);
+            decodeNsecs += timer.nsecsElapsed();
+        }
+        else if (packet.stream_index == streamIndex) {
+            timer.start();
+            decoded = decoder.decodeFrames(&packet, false);
+            decodeNsecs += timer.nsecsElapsed();
+        }
+        av_packet_unref(&packet);
+
+        for (int i = 0; i < decoded.count(); i++) {
+            if (decoded[i]->getFrameType() != FFFrame::FFFrameTypeVideo) {
+                continue;
+            }
+
+            timer.start();
+            decoder.convertFrame(decoded[i]);
+            convertNsecs += timer.nsecsElapsed();
+
+            frames++;
+        }
+    }
+
+    allocations = sAllocations.load() - allocations;
+    imageAllocations = framePool.missCount() - imageAllocations;
+
+    avformat_close_input(&formatContext);
+
+    result["packets"] = static_cast<double>(packets);
+    result["bytes"] = static_cast<double>(bytes);
+    result["frames"] = static_cast<double>(frames);
+    result["demuxFps"] = perSecond(packets, demuxNsecs);
+    result["decodeFps"] = perSecond(frames, decodeNsecs);
+    result["convertFps"] = perSecond(frames, convertNsecs);
+    result["allocationsPerFrame"] = frames > 0 ? static_cast<double>(allocations) / frames : 0.0;
+    result["imageAllocationsPerFrame"] = frames > 0 ? static_cast<double>(imageAllocations) / frames : 0.0;
+
+    return result;
+}
+
+// From open() to the first video frame delivered by a player.
+static QJsonObject benchmarkOpen(const QString &path, const FFDecoderOptions &options) {
+    QJsonObject result;
+
+    FFPlayer player;
+    player.setDecoderOptions(options);
+
+    QEventLoop loop;
+    QElapsedTimer timer;
+    qint64 timeToFirstFrame = -1;
+
+    QObject::connect(&player, &FFPlayer::contentDidOpened, &loop, [&player]() {
+        player.play();
+    });
+    QObject::connect(&player, &FFPlayer::updateVideoFrame, &loop, [&](FFVideoFramePtr) {
+        if (timeToFirstFrame < 0) {
+            timeToFirstFrame = timer.elapsed();
+            loop.quit();
+        }
+    });
+    QObject::connect(&player, &FFPlayer::contentDidClosed, &loop, &QEventLoop::quit);
+    QTimer::singleShot(OPEN_TIMEOUT, &loop, &QEventLoop::quit);
+
+    timer.start();
+    player.open(QUrl::fromLocalFile(path));
+    loop.exec();
+
+    FFPlayer::OpenLatency latency = player.openLatency();
+    player.close();
+
+    result["timeToFirstFrame"] = static_cast<double>(timeToFirstFrame);
+    result["openInput"] = static_cast<double>(latency.openInput);
+    result["streamInfo"] = static_cast<double>(latency.streamInfo);
+    result["decoderOpen"] = static_cast<double>(latency.decoderOpen);
+
+    return result;
+}
+
+static QList<QSize> parseSizes(const QString &value) {
+    QList<QSize> sizes;
+
+    QStringList items = value.split(',', QString::SkipEmptyParts);
+    for (int i = 0; i < items.count(); i++) {
+        QStringList dimensions = items[i].split('x');
+        if (dimensions.count() == 2 && dimensions[0].toInt() > 0 && dimensions[1].toInt() > 0) {
+            sizes << QSize(dimensions[0].toInt(), dimensions[1].toInt());
+        }
+    }
+
+    return sizes;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ffbenchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Demux, decode and conversion benchmark of FFPlayer.");
+    parser.addHelpOption();
+
+    QCommandLineOption ffmpegOption("ffmpeg", "ffmpeg binary generating the media.", "path", "ffmpeg");
+    QCommandLineOption mediaOption("media-dir", "Directory of the generated media.", "path",
+                                   QDir::temp().filePath("ffbenchmark-media"));
+    QCommandLineOption durationOption("duration", "Seconds of generated media.", "sec",
+                                      QString::number(DEFAULT_DURATION));
+    QCommandLineOption codecsOption("codecs", "Codecs to benchmark.", "list", "h264,hevc,vp9,mpeg4");
+    QCommandLineOption sizesOption("sizes", "Source resolutions.", "list", "640x360,1920x1080,3840x2160");
+    QCommandLineOption scaleOption("scale", "Output size of the conversion, source size if not set.", "WxH");
+    QCommandLineOption threadsOption("threads", "Codec threads, 0 picks one per core.", "count", "0");
+    QCommandLineOption outputOption("output", "JSON results, stdout if not set.", "path");
+
+    parser.addOption(ffmpegOption);
+    parser.addOption(mediaOption);
+    parser.addOption(durationOption);
+    parser.addOption(codecsOption);
+    parser.addOption(sizesOption);
+    parser.addOption(scaleOption);
+    parser.addOption(threadsOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    avcodec_register_all();
+    av_register_all();
+    av_log_set_level(AV_LOG_QUIET);
+
+    QString mediaDirectory = parser.value(mediaOption);
+    QDir().mkpath(mediaDirectory);
+
+    int duration = qMax(1, parser.value(durationOption).toInt());
+    QStringList codecs = parser.value(codecsOption).split(',', QString::SkipEmptyParts);
+    QList<QSize> sizes = parseSizes(parser.value(sizesOption));
+
+    FFDecoderOptions options;
+    options.threadCount = qMax(0, parser.value(threadsOption).toInt());
+    if (parser.isSet(scaleOption)) {
+        QList<QSize> scale = parseSizes(parser.value(scaleOption));
+        if (!scale.isEmpty()) {
+            options.outputSize = scale.first();
+        }
+    }
+
+    QJsonArray results;
+    QList<MediaSpec> specs = mediaSpecs();
+
+    for (int i = 0; i < specs.count(); i++) {
+        if (!codecs.contains(specs[i].codec)) {
+            continue;
+        }
+
+        for (int j = 0; j < sizes.count(); j++) {
+            QJsonObject result;
+            result["codec"] = specs[i].codec;
+            result["source"] = QString("%1x%2").arg(sizes[j].width()).arg(sizes[j].height());
+
+            QString path = generateMedia(parser.value(ffmpegOption), mediaDirectory,
+                                         specs[i], sizes[j], duration);
+            if (path.isEmpty()) {
+                // E.g. ffmpeg built without the encoder.
+                result["error"] = QString("media not generated");
+                results.append(result);
+                continue;
+            }
+
+            result["file"] = QFileInfo(path).fileName();
+            result["pipeline"] = benchmarkPipeline(path, options);
+            result["open"] = benchmarkOpen(path, options);
+            results.append(result);
+        }
+    }
+
+    QJsonObject root;
+    root["version"] = 1;
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["qt"] = QString(qVersion());
+    root["avcodec"] = QString(LIBAVCODEC_IDENT);
+    root["os"] = QSysInfo::prettyProductName();
+    root["cpuCount"] = QThread::idealThreadCount();
+    root["codecThreads"] = options.threadCount;
+    root["results"] = results;
+    root["peakRss"] = static_cast<double>(peakRss());
+
+    QByteArray json = QJsonDocument(root).toJson();
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            return 1;
+        }
+    }
+    else {
+        QFile output;
+        output.open(stdout, QIODevice::WriteOnly);
+        output.write(json);
+    }
+
+    return 0;
+}